@@ -1,20 +1,47 @@
 // ================================================================
 // River Raid (versão de terminal) — C + ncurses
-// NÍVEL: Iniciante
-// Objetivo: Criar um jogo simples de River Raid no terminal usando C e ncurses.
+// NÍVEL: Avançado. Começou como exercício de iniciante; o jogo em si
+//        (atualizarJogo e o que ele chama: rio, inimigos, balas,
+//        desenho) continua em funções curtas, mas em volta dele há
+//        threads de desenho, placar e telemetria, filas sem trava,
+//        mmap/flock, SSE2 e um lote com roubo de trabalho.
+// Objetivo: Criar um jogo de River Raid no terminal usando C e ncurses.
 //           O jogo envolve um jogador (avião) que deve navegar por um rio, evitando as margens.
-// Controles: ←/→  ou  A/D  para mover;  R para reiniciar;  Q para sair
+// Controles: ←/→  ou  A/D  para mover;  espaço atira;  V volta 3 s;
+//            R para reiniciar;  Q para sair
 // Compilar (macOS):
-//     gcc river_raid.c  -o river_raid -lncurses
+//     gcc river_raid.c  -o river_raid -lncurses -pthread
 // Executar:
 //     ./river_raid
+//     ./river_raid --headless --quadros 1000000   (simulação sem tela)
 // ================================================================
 
+#define _GNU_SOURCE // clock_gettime/clock_nanosleep mesmo com -std=c11 no Linux
+
 #include <ncurses.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h> // SSE2: moverEntidades de 8 em 8
+#endif
 
 // ----------------------------
 // ESTRUTURAS DE DADOS SIMPLES
@@ -28,46 +55,64 @@ typedef struct
     int fuel; // NOVO: combustível
 } Player;
 
+// Vagas livres: pilha de índices. Nascer e morrer custam O(1), sem
+// procurar um '!vivo' no vetor. Vaga em falta conta como rejeição.
 typedef struct
 {
-    int x;
-    int y;
-    int vivo;
-} Inimigo;
+    int *livres;
+    int nLivres;
+    long rejeitados;
+} ListaVagas;
 
-#define INIMIGOS_MAX 20
-Inimigo inimigos[INIMIGOS_MAX];
+// Entidades que descem com o rio (inimigos e postos de gasolina), em
+// estrutura de vetores: x[] e y[] de 16 bits + 1 bit "vivo" por vaga.
+// Os vetores têm folga até múltiplo de 64, então moverEntidades roda
+// sem casos de borda (e o compilador/SSE2 processa 8 vagas por vez).
+typedef struct
+{
+    int16_t *x;
+    int16_t *y;
+    uint64_t *vivo; // bit i da palavra i / 64 = vaga i ocupada
+    int cap;
+    int nPalavras; // (cap + 63) / 64
+    ListaVagas vagas;
+} Entidades;
+
+#define INIMIGOS_PADRAO 20
+int capInimigos = INIMIGOS_PADRAO; // --inimigos N
 
 // ============================
 // TIROS
 // ============================
-typedef struct Bala
-{
-    int x, y;
-    struct Bala *prox;
-} Bala;
-
-Bala *balas = NULL;
+// Vetores fixos (x[], y[]) + quantidade viva: nenhum malloc durante o
+// jogo. Para remover, a última bala ocupa o lugar da que saiu.
+#ifndef BALAS_MAX
+#define BALAS_MAX 256
+#endif
+int cadenciaTiro = 1; // passos mínimos entre dois tiros (--cadencia)
 
 // ============================
 // GASOLINA
 // ============================
-typedef struct
-{
-    int x;
-    int y;
-    int vivo;
-} Gasolina;
-
-#define GASOLINA_MAX 5
-Gasolina postos[GASOLINA_MAX];
+#define GASOLINA_PADRAO 5
+int capPostos = GASOLINA_PADRAO; // --postos N
 
 // ----------------------------
 int LARGURA = 0;
 int ALTURA = 0;
 
-int *margemEsq = NULL;
-int *margemDir = NULL;
+// Margens do rio: anel de linhas (esq, dir e ilha) com um índice de topo
+// que anda a cada quadro. Rolar o rio 1 linha custa O(1): basta mover o
+// topo e escrever a linha nova. Acesse sempre por linhaDoRio(y).
+// Água = colunas entre esq e dir, menos a ilha [ilhaEsq, ilhaDir).
+typedef struct
+{
+    int esq;
+    int dir;
+    int ilhaEsq, ilhaDir;    // ilhaEsq == ilhaDir: sem ilha
+    unsigned char secao;     // SECAO_* do modelo que gerou a linha
+    unsigned char inicioSecao; // 1 na primeira linha da seção
+} LinhaRio;
 
 #define AVIAO_H 3
 #define AVIAO_W 5
@@ -84,563 +129,4860 @@ const char *INIMIGO[INIMIGO_H] = {
     "\\ooo/",
     " === "};
 
-int LARGURA_MIN = 0;
+// Máscaras de colisão (ver compilarMascaras)
+#define MASCARA_H_MAX 8
+typedef struct
+{
+    int h, w;
+    uint32_t linhas[MASCARA_H_MAX];
+} Mascara;
+
+_Static_assert(AVIAO_W <= 32 && INIMIGO_W <= 32, "sprite largo demais para a máscara");
+_Static_assert(AVIAO_H <= MASCARA_H_MAX && INIMIGO_H <= MASCARA_H_MAX, "sprite alto demais");
+
+Mascara mascaraAviao;
+Mascara mascaraInimigo;
+
+int LARGURA_MIN = 0; // canal mais estreito (cabe o avião com folga)
 int LARGURA_MAX = 0;
 
+// Terreno por seções, como no Atari: reto -> ilha -> canal estreito -> ...
+// As linhas são geradas em lotes numa fila à frente da tela; o quadro só
+// tira a próxima linha pronta.
+enum
+{
+    SECAO_RETA,
+    SECAO_ILHA,
+    SECAO_CANAL,
+    NSECOES
+};
+typedef struct
+{
+    const char *nome;
+    int compMin, compMax; // comprimento da seção em linhas
+    int larguraPct;       // largura alvo do rio, em % de LARGURA
+    int ilhaPct;          // largura da ilha, em % da largura do rio (0 = sem)
+} ModeloSecao;
+ModeloSecao modelosSecao[NSECOES] = {
+    {"reta", 60, 120, 45, 0},
+    {"ilha", 60, 100, 65, 35},
+    {"canal", 40, 70, 15, 0},
+};
+int cicloSecoes[] = {SECAO_RETA, SECAO_ILHA, SECAO_CANAL};
+#define NCICLO (int)(sizeof cicloSecoes / sizeof cicloSecoes[0])
+
+typedef struct
+{
+    int posCiclo;  // índice em cicloSecoes
+    int restantes; // linhas que faltam na seção atual
+    int centro, largura, ilha;
+    int alvoLargura, alvoIlha; // do modelo, calculados no início da seção
+} GeradorRio;
+
+#define LOOKAHEAD_LINHAS 512 // linhas prontas à frente da tela
+#define LOTE_TERRENO 128     // gera quando sobram menos que isso de folga
+#define ANTECEDENCIA_POSTO 12 // posto garantido estas linhas antes de um canal
+
 // Tick dinâmico: começa lento e acelera
 #define TICK_START_USEC 100000 // 0.01 s por quadro (≈10 FPS)
 #define TICK_MIN_USEC 20000    // limite de 0.02 s (≈50 FPS)
-useconds_t tick_usec = TICK_START_USEC;
+#define PASSOS_ATRASO_MAX 5 // máx. de passos recuperados de uma vez
 
-// ----------------------------
-void iniciarNcurses(void);
-void finalizarNcurses(void);
-void criarRioInicial(void);
-void gerarNovaLinhaNoTopo(void);
-void desenharTudo(const Player *p);
-void desenharAviao(const Player *p);
-int haColisao(const Player *p);
-void ReiniciarInimigos(void);
-void reiniciarJogo(Player *p);
-// Tiros
-void iniciarBalas(void);
-void destruirBalas(void);
-void disparar(const Player *p);
-void atualizarBalas(Player *p);
-void desenharBalas(void);
-// Gasolina
-void ReiniciarGasolina(void);
+// Números aleatórios: um fluxo PCG32 por subsistema (ver rngProximo)
+typedef struct
+{
+    uint64_t estado;
+    uint64_t inc;
+} Rng;
 
-// ================================================================
-// MAIN
-// ================================================================
-int main(void)
+uint64_t semente = 0; // --seed N (sem ela: relógio)
+int sementeDada = 0;
+Rng rngBench; // montagem dos cenários de benchmark
+
+// Telemetria (--eventos ARQ): abates, coletas, mortes (com a causa),
+// nascimentos e acelerações num fluxo binário. Cada thread que joga
+// escreve no seu anel (um produtor, um consumidor, sem trava) e a thread
+// de descarga esvazia os anéis no arquivo.
+enum
 {
-    srand((unsigned)time(NULL));
-    iniciarNcurses();
+    EVENTO_ABATE = 1, // x/y da bala, valor = score depois do abate
+    EVENTO_COLETA,    // x/y do posto, valor = combustível antes
+    EVENTO_MORTE,     // x/y do avião, valor = score, causa = CAUSA_*
+    EVENTO_INIMIGO,   // inimigo nasceu em x
+    EVENTO_POSTO,     // posto nasceu em x
+    EVENTO_ACELERA,   // valor = novo tick_usec
+    EVENTO_RECOMECO,  // nova vida
+    EVENTO_VOLTA,     // rebobinou; valor = passos voltados
+    NEVENTOS
+};
+enum
+{
+    CAUSA_MARGEM = 1,
+    CAUSA_INIMIGO,
+    CAUSA_COMBUSTIVEL,
+    NCAUSAS
+};
+typedef struct
+{
+    uint32_t partida; // 0 com tela/headless; k no lote
+    uint32_t passo;   // passos desde o começo da vida (contadorLinha - inicioVida)
+    int32_t valor;
+    int16_t x, y;
+    uint8_t tipo;  // EVENTO_*
+    uint8_t causa; // CAUSA_* (só na morte)
+    uint16_t reservado;
+} Evento;
+#define EVENTOS_ANEL 65536 // eventos por anel (potência de 2)
+typedef struct
+{
+    Evento *anel;
+    _Alignas(64) atomic_ulong cabeca; // só o produtor escreve
+    unsigned long caudaVista;         // última cauda lida pelo produtor
+    uint32_t partida;
+    long transbordos;                 // eventos perdidos com o anel cheio
+    _Alignas(64) atomic_ulong cauda;  // só a thread de descarga escreve
+} Telemetria;
 
+// Uma partida: tudo o que a simulação muda a cada passo. O tamanho do
+// mundo e as capacidades (LARGURA, capInimigos, ...) são comuns a todas
+// e só são lidos, então várias partidas podem rodar ao mesmo tempo, uma
+// por thread (--lote).
+typedef struct
+{
     Player jogador;
-    reiniciarJogo(&jogador);
+    Entidades inimigos;
+    Entidades postos;
 
-    int contadorLinha = 0;
-    int contadorSpawn = 0;
-    int limiteSpawn = 20;
-    int fuelTick = 0; // conta ciclos para gastar combustível
+    // Índice por linha da tela, refeito 1x por passo (indexarInimigos):
+    // os inimigos cujo topo está na linha y são
+    // inimigosPorLinha[inicioLinha[y] .. inicioLinha[y + 1] - 1].
+    int *inicioLinha; // ALTURA + 1 posições
+    int *inimigosPorLinha;
 
-    while (1)
-    {
-        int ch = getch();
-        if (ch == 'q' || ch == 'Q')
-            break;
+    // Tiros (ver TIROS)
+    int balaX[BALAS_MAX];
+    int balaY[BALAS_MAX];
+    int nBalas;
+    int ultimoTiro; // contadorLinha do último tiro
 
-        if (jogador.vivo)
-        {
-            if (ch == KEY_LEFT || ch == 'a' || ch == 'A')
-                jogador.x--;
-            if (ch == KEY_RIGHT || ch == 'd' || ch == 'D')
-                jogador.x++;
-            if (ch == ' ')
-                disparar(&jogador);
+    LinhaRio *rio;      // anel de ALTURA linhas (ver linhaDoRio)
+    int topoRio;        // posição no anel da linha y = 0 (topo da tela)
+    long linhasRoladas; // total de linhas geradas (o rio desceu tudo isso)
+    GeradorRio gerador;
+    LinhaRio filaRio[LOOKAHEAD_LINHAS];
+    int filaRioInicio, filaRioN;
+    int postoPlanejado;
 
-            if (jogador.x < 1)
-                jogador.x = 1;
-            int maxX = LARGURA - AVIAO_W - 1;
-            if (jogador.x > maxX)
-                jogador.x = maxX;
+    Rng rngTerreno;  // gerarNovaLinhaNoTopo
+    Rng rngInimigos; // posição X dos inimigos
+    Rng rngPostos;   // sorteio e posição do [FUEL]
+    Rng rngEntrada;  // teclas aleatórias do modo headless
 
-            contadorLinha++;
+    int contadorLinha;
+    int contadorSpawn;
+    int limiteSpawn;
+    int fuelTick; // conta ciclos para gastar combustível
+    int inicioVida; // contadorLinha no começo da vida atual
+    useconds_t tick_usec;
 
-            gerarNovaLinhaNoTopo();
+    char *arena; // dona de rio, índice e entidades (ver alocarJogo)
+    size_t tamArena;
+    Telemetria *eventos; // NULL: não registra (cópias do piloto, benchmarks)
+} Jogo;
+Jogo jogo; // a partida da tela, do headless e dos benchmarks
 
-            for (int i = 0; i < INIMIGOS_MAX; i++)
-            {
-                if (inimigos[i].vivo)
-                {
-                    inimigos[i].y++;
-                    if (inimigos[i].y >= ALTURA)
-                        inimigos[i].vivo = 0;
-                }
-            }
+// Piloto automático (--piloto): a cada passo testa cada ação em cópias
+// da partida, alguns passos à frente, e fica com a melhor
+#define PILOTO_HORIZONTE 32 // passos simulados por ensaio
+#define PILOTO_SEGURA 4     // passos com a ação testada antes das sorteadas
+#define PILOTO_ENSAIOS 3    // ensaios por ação (vale o melhor)
+typedef struct
+{
+    Jogo ensaio;       // cópia onde cada ramo é jogado
+    Rng rng;           // continuações sorteadas dos ensaios
+    long decisoes;
+    long long nos;     // passos simulados nos ensaios
+    long long tempoNs; // gasto decidindo
+} Piloto;
+int pilotoLigado = 0;
+Piloto piloto; // o da partida principal (no lote, um por thread)
 
-            contadorSpawn++;
-            if (contadorSpawn > limiteSpawn)
-            {
-                contadorSpawn = 0;
-                for (int i = 0; i < INIMIGOS_MAX; i++)
-                {
-                    if (!inimigos[i].vivo)
-                    {
-                        inimigos[i].vivo = 1;
-                        inimigos[i].y = 0;
-                        inimigos[i].x = margemEsq[0] + 1 + rand() % (margemDir[0] - margemEsq[0] - INIMIGO_W - 1);
-                        break;
-                    }
-                }
-            }
+// Instantâneo da partida: cabeçalho, cópia do Jogo e a arena logo depois,
+// num bloco só e sem ponteiro que valha fora dele (restaurar refaz os
+// ponteiros). Salvar e restaurar são cópias do tamanho do bloco.
+#define INSTANTANEO_MAGICA 0x52535452u // "RTSR"
+#define INSTANTANEO_VERSAO 1
+typedef struct
+{
+    uint32_t magica, versao;
+    uint64_t tamanho;          // bytes do bloco inteiro (muda com mundo e capacidades)
+    Jogo jogo;                 // os ponteiros daqui não valem
+    _Alignas(64) char arena[]; // j->tamArena bytes
+} Instantaneo;
 
-            // ======== GASOLINA DESCENDO =========
-            for (int i = 0; i < GASOLINA_MAX; i++)
-            {
-                if (postos[i].vivo)
-                {
-                    postos[i].y++;
-                    if (postos[i].y >= ALTURA)
-                        postos[i].vivo = 0;
-                }
-            }
+// Rebobinar ('v'): um instantâneo por passo num anel com espaço para
+// REBOBINAR_SEGUNDOS no ritmo mais rápido (TICK_MIN_USEC), alocado uma
+// vez. Voltar é uma ação gravada como as outras, então o replay refaz.
+#define REBOBINAR_SEGUNDOS 3
+typedef struct
+{
+    char *memoria; // cap blocos de 'tamanho' bytes
+    size_t tamanho;
+    int cap, inicio, n;
+    long salvos, rebobinadas;
+    long long somaNs; // gasto salvando
+} AnelInstantaneos;
+AnelInstantaneos anel; // cap 0: rebobinar desligado
 
-            // ======== NASCER GASOLINA =========
-            if (rand() % 100 < 3)
-            {
-                for (int i = 0; i < GASOLINA_MAX; i++)
-                {
-                    if (!postos[i].vivo)
-                    {
-                        postos[i].vivo = 1;
-                        postos[i].y = 0;
-                        postos[i].x = margemEsq[0] + 1 + rand() % (margemDir[0] - margemEsq[0] - 2);
-                        break;
-                    }
-                }
-            }
+// Placar (--placar ARQ): recordes num arquivo mapeado em memória, só de
+// acréscimo. Cabeçalho, os registros e depois deles o índice (posições
+// dos registros em ordem de score). Um registro só vale quando o
+// cabeçalho já conta com ele (confirmados), então um arquivo cortado no
+// meio de uma escrita perde só o que não foi confirmado.
+#define PLACAR_MAGICA "RRPL"
+#define PLACAR_VERSAO 2         // 1: sem índice no arquivo (ainda abre)
+#define PLACAR_CAP_INICIAL 4096 // registros; o arquivo dobra quando enche
+#define PLACAR_FILA 4096        // pedidos à espera da thread (potência de 2)
+#define PLACAR_DELTA 1024       // registros fora de ordem antes de fundir no índice
+#define PLACAR_RASCUNHO (PLACAR_DELTA + PLACAR_FILA) // maior delta possível
+#define PLACAR_ESPERA_NS 10000000LL // a thread olha a fila a cada 10 ms
+#define ORIGEM_TELA 0
+#define ORIGEM_HEADLESS 1
+#define ORIGEM_LOTE 2
+#define ORIGEM_PILOTO 4 // somado aos de cima
+typedef struct
+{
+    char magica[4];
+    uint32_t versao;
+    uint64_t confirmados;  // registros válidos; o resto do arquivo é lixo
+    uint64_t capacidade;   // registros que cabem; o índice começa depois deles
+    uint64_t ordenados;    // os primeiros 'ordenados' registros estão na base do índice
+    uint32_t indiceEmObra; // 1 durante uma fusão: quem abrir refaz o índice
+    uint32_t livre;
+    uint64_t reservado[3]; // cabeçalho de 64 bytes
+} CabecalhoPlacar;
+typedef struct
+{
+    int64_t score;
+    uint64_t semente;
+    int64_t quando;  // time() da morte
+    uint32_t passo;  // passo da partida em que morreu
+    uint32_t origem; // ORIGEM_*
+} RegistroPlacar;
+typedef struct
+{
+    atomic_ulong seq; // fila de Vyukov: diz se a vaga está livre ou cheia
+    RegistroPlacar r;
+} VagaPlacar;
+typedef struct
+{
+    int fd;
+    CabecalhoPlacar *cab; // o arquivo inteiro mapeado a partir daqui
+    RegistroPlacar *reg;  // logo depois do cabeçalho
+    uint32_t *ordem;      // base do índice, logo depois dos registros
+    size_t capacidade;    // registros que cabem no mapa
+    uint32_t delta[PLACAR_RASCUNHO]; // rascunho para ordenar o delta
+    // Fila sem trava: várias threads põem, só a do placar tira
+    VagaPlacar fila[PLACAR_FILA];
+    _Alignas(64) atomic_ulong cauda;
+    _Alignas(64) unsigned long cabeca;
+    RegistroPlacar pegos[PLACAR_FILA]; // o que a thread tirou numa volta
+    atomic_int parar;
+    pthread_t thread;
+    // Para quem não pode esperar: lido com atomic_load, sem trava
+    _Alignas(64) atomic_long enviados, processados, ultimaPosicao, total;
+    atomic_long perdidos; // fila cheia na tela/headless
+    long descargas;       // msync de registros + cabeçalho
+} Placar;
+Placar placar;
+const char *caminhoPlacar = NULL; // --placar ARQ
+int placarLigado = 0;
+long topPlacar = 0; // --placar-top K: lista e sai
 
-            atualizarBalas(&jogador);
+// Arquivo de eventos: cabeçalho (RREV, versão, semente, mundo, total e
+// transbordos, preenchidos ao fechar) e depois os Evento em binário
+#define EVENTOS_MAGICA "RREV"
+#define EVENTOS_VERSAO 1
+#define EVENTOS_ESPERA_NS 2000000LL // a descarga olha os anéis a cada 2 ms
+const char *caminhoEventos = NULL;   // --eventos ARQ
+const char *caminhoLerEventos = NULL; // --ler-eventos ARQ
+FILE *arquivoEventos = NULL;
+Telemetria *aneisEventos = NULL; // um por thread que joga
+int nAneisEventos = 0;
+atomic_int pararDescarga = 0;
+pthread_t threadDescarga;
+long long eventosGravados = 0; // só a thread de descarga
 
-            if (contadorLinha % 100 == 0)
-            {
-                jogador.score += 10; // 10 Pontos por tempo sobrevivido
-            }
+// Modo headless: roda a simulação sem terminal e sem dormir
+int modoHeadless = 0;
+long quadrosHeadless = 1000000;
+const char *roteiroEntrada = NULL; // teclas em ciclo; NULL = aleatório
 
-            if (contadorLinha % 120 == 0 && tick_usec > TICK_MIN_USEC)
-            {
-                tick_usec -= 2000; // acelera um pouquinho
-                if (tick_usec < TICK_MIN_USEC)
-                    tick_usec = TICK_MIN_USEC;
-            }
+// Lote (--lote N): N partidas com sementes seguidas, em várias threads.
+// Cada thread tem uma faixa [inicio, fim) de partidas numa palavra
+// atômica; a dona tira do início e quem ficou sem trabalho rouba a
+// metade final da faixa de outra (compare-and-swap nos dois casos).
+#define LOTE_MAX_THREADS 256
+typedef struct
+{
+    _Alignas(64) atomic_ullong faixa; // (inicio << 32) | fim
+    _Alignas(64) long partidas;       // contadores só da própria thread
+    long roubos;
+    long long nos; // passos de ensaio do piloto
+    int id;
+    pthread_t thread;
+} TrabalhadorLote;
+long nLote = 0;      // --lote N
+int threadsLote = 0; // --threads N (0 = uma por CPU)
+TrabalhadorLote *trabalhadores = NULL;
+long *scoreLote = NULL;   // por partida, escrito só por quem a jogou
+long *quadrosLote = NULL; // passos até morrer (sobrevivência)
 
-            if (contadorLinha % 500 == 0 && limiteSpawn > 3)
-                limiteSpawn--;
+const char *benchEscolhido = NULL; // --bench NOME
+const char *caminhoBase = NULL;    // --base ARQ: CSV de um --bench nucleo anterior
 
-            // Coleta gasolina
-            for (int i = 0; i < GASOLINA_MAX; i++)
-            {
-                if (postos[i].vivo &&
-                    postos[i].x >= jogador.x &&
-                    postos[i].x < jogador.x + AVIAO_W &&
-                    postos[i].y >= jogador.y &&
-                    postos[i].y < jogador.y + AVIAO_H)
-                {
-                    postos[i].vivo = 0;
-                    jogador.fuel = 100;
-                }
-            }
+// Entrada do jogo: um byte de ações por passo da simulação
+#define ACAO_ESQ 1
+#define ACAO_DIR 2
+#define ACAO_TIRO 4
+#define ACAO_REINICIAR 8
+#define ACAO_VOLTAR 16 // rebobina REBOBINAR_SEGUNDOS
 
-            // Consome combustível
-            fuelTick++;
-            if (fuelTick >= 8) // gasta 1 unidade a cada 8 ciclos
-            {
-                fuelTick = 0;
-                jogador.fuel--;
-            }
-            if (jogador.fuel <= 0)
-                jogador.vivo = 0;
+// Estado da entrada no jogo com tela: o loop lê todas as teclas da fila
+// a cada quadro (o ncurses não avisa quando uma tecla é solta)
+#define SEGURAR_NS 60000000LL           // direção segue "segurada" por 60 ms
+#define JANELA_REPETICAO_NS 700000000LL // nova tecla igual antes disso = auto-repeat
+#define INTERVALO_AUTOREPEAT_NS 100000000LL // repetições seguidas chegam mais perto que isso
+typedef struct
+{
+    unsigned pendentes;        // ações ainda não usadas por um passo
+    long long seguraAte[2];    // esquerda/direita seguradas até este instante
+    long long ultimaTecla[5];  // último aperto de cada ação (índice do bit)
+    int teclaNova;             // chegou tecla que não é auto-repeat
+    long long chegada;         // chegada da tecla mais antiga ainda não usada
+    long lidas;                // teclas lidas da fila
+    long velhas;               // repetições descartadas (já cobertas no quadro)
+    int maxVelhasQuadro;
+} EstadoEntrada;
+EstadoEntrada entrada;
 
-            if (haColisao(&jogador))
-                jogador.vivo = 0;
-        }
-        else
-        {
-            if (ch == 'r' || ch == 'R')
-                reiniciarJogo(&jogador);
-        }
+// Atraso tecla -> passo (amostras em anel para o p99 do resumo)
+#define AMOSTRAS_ATRASO 1024
+long long amostrasAtraso[AMOSTRAS_ATRASO];
+long nAtrasos = 0;
+long long somaAtraso = 0, maxAtraso = 0;
+int baixaLatencia = 0; // --baixa-latencia: tecla nova roda um passo na hora
+int relogioFd = -1;    // timerfd do quadro (Linux); -1 = poll com timeout
 
-        desenharTudo(&jogador);
-        usleep(tick_usec);
-    }
+// Retrato: tudo o que o desenho precisa de um passo, copiado pela
+// simulação. A thread de desenho só lê retratos, nunca o mundo.
+typedef struct
+{
+    LinhaRio *margens; // ALTURA linhas, de cima para baixo
+    int16_t *inimigoX, *inimigoY;
+    int nInimigos;
+    int16_t *postoX, *postoY;
+    int nPostos;
+    int balaX[BALAS_MAX], balaY[BALAS_MAX];
+    int nBalas;
+    Player jogador;
+    long linhasRoladas;
+    long posicaoPlacar, totalPlacar; // da última morte; 0 = ainda sem posição
+    char perfil[2][160]; // linhas do --perfil
+} Retrato;
 
-    finalizarNcurses();
-    return 0;
-}
+// Buffer triplo sem trava: a simulação escreve em um retrato, o desenho
+// lê outro e o terceiro fica "no meio", trocado com atomic_exchange.
+#define RETRATO_NOVO 4 // bit em retratoMeio: o do meio ainda não foi lido
+Retrato retratos[3];
+Retrato retratoLocal; // desenho sem threads (benchmarks)
+int retratoEscrita = 0, retratoLeitura = 1;
+atomic_int retratoMeio = 2;
+long retratosPublicados = 0, retratosDesenhados = 0;
+long long somaDesenhoNs = 0;
+atomic_llong ultimoDesenhoNs = 0;
+
+// Thread de desenho: dona do ncurses (desenho e getch). Teclas vão para
+// a simulação por uma fila de produtor/consumidor únicos.
+#define FILA_TECLAS 256
+typedef struct
+{
+    int ch;
+    long long chegada;
+} TeclaLida;
+TeclaLida filaTeclas[FILA_TECLAS];
+atomic_uint filaCabeca = 0, filaCauda = 0; // cabeça: simulação lê; cauda: desenho escreve
+long teclasPerdidas = 0;
+pthread_t threadDesenho;
+atomic_int fimDesenho = 0;
+int campainhaDesenho[2] = {-1, -1}; // simulação -> desenho: retrato novo
+int avisoTeclas[2] = {-1, -1};      // desenho -> simulação: tecla nova
+
+// Gravação (--gravar) e replay (--replay) das ações, com RLE
+const char *caminhoGravacao = NULL;
+const char *caminhoReplay = NULL;
+FILE *arquivoGravacao = NULL;
+FILE *arquivoReplay = NULL;
+unsigned acaoGravada = 0;  // ação da sequência aberta na gravação
+long repeticoesGravadas = 0;
+unsigned acaoReplay = 0;   // ação da sequência sendo reproduzida
+long repeticoesReplay = 0;
+double velocidade = 1.0;   // --velocidade: multiplica a taxa de passos
+
+// Perfil por fase do quadro (--perfil / --perfil-csv)
+enum
+{
+    FASE_ENTRADA,
+    FASE_PILOTO,
+    FASE_REBOBINAR,
+    FASE_RIO,
+    FASE_ENTIDADES,
+    FASE_BALAS,
+    FASE_COLETA,
+    FASE_COLISAO,
+    FASE_PUBLICAR,
+    FASE_ESPERA,
+    NFASES
+};
+const char *nomesFases[NFASES] = {"entrada", "piloto", "rebobinar", "rio", "entidades", "balas",
+                                  "coleta", "colisao", "publicar", "espera"};
+#define JANELA_PERFIL 256  // quadros usados na média/p99/máx do HUD
+int perfilLigado = 0;
+int perfilPausado = 0; // piloto jogando cópias: os passos delas não contam
+const char *caminhoPerfilCsv = NULL;
+FILE *arquivoPerfilCsv = NULL;
+long long marcaPerfil = 0;          // instante da última marca de fase
+long long tempoFase[NFASES];        // ns gastos em cada fase no quadro atual
+long long janelaPerfil[NFASES][JANELA_PERFIL];
+int nJanelaPerfil = 0, posJanelaPerfil = 0;
+long quadrosPerfil = 0;
+
+// Tela e câmera: o mundo (LARGURA x ALTURA) pode ser maior ou menor que
+// a tela; a câmera diz qual pedaço do mundo aparece
+int larguraTela = 0, alturaTela = 0;
+int cameraX = 0, cameraY = 0;
+int cameraYNaTela = 0;
+int mundoDado = 0; // --mundo LxA (ou replay): o mundo não segue a tela
+
+// Quadros de desenho (só existem com ncurses)
+chtype *quadro = NULL;       // cena sendo montada neste quadro
+chtype *quadroNaTela = NULL; // o que o terminal está mostrando
+long linhasNaTela = 0;       // valor de linhasRoladas no último desenho
+long celulasNoQuadro = 0;    // células enviadas no último quadro
+long celulasTotal = 0;
+long quadrosDesenhados = 0;
+long chamadasCurses = 0;     // chamadas ao ncurses feitas pelo desenho
+
+// ----------------------------
+void iniciarNcurses(void);
+void finalizarNcurses(void);
+void alocarMundo(void);
+void liberarMundo(void);
+void definirLimitesDoRio(void);
+int alocarJogo(Jogo *j);
+void liberarJogo(Jogo *j);
+void *pedacoDaArena(char *arena, size_t *usado, size_t bytes);
+void apontarEntidades(Entidades *e, char *arena, size_t *usado, int capacidade);
+size_t apontarArena(Jogo *j, char *arena);
+void copiarJogo(Jogo *dst, const Jogo *src);
+void novaPartida(Jogo *j, uint64_t s);
+void atualizarJogo(Jogo *j, unsigned acoes);
+void passoDoJogo(Jogo *j, unsigned acoes);
+unsigned teclaParaAcoes(int ch);
+int drenarEntrada(EstadoEntrada *e);
+unsigned acoesDoPasso(EstadoEntrada *e, long long agora);
+void iniciarRelogioQuadro(void);
+void finalizarRelogioQuadro(void);
+int esperarEvento(long long prazoNs);
+// Pipeline simulação/desenho
+int alocarRetrato(Retrato *r);
+void liberarRetrato(Retrato *r);
+void capturarRetrato(Retrato *r, const Jogo *j);
+void desenharRetrato(const Retrato *r);
+void publicarRetrato(const Jogo *j);
+const Retrato *pegarRetratoNovo(void);
+int porTecla(int ch, long long chegada);
+int tirarTecla(int *ch, long long *chegada);
+void tocar(int fd);
+int abrirPipeSemEspera(int fds[2]);
+void esvaziarAviso(int fd);
+void *lacoDesenho(void *arg);
+void iniciarPipeline(void);
+void finalizarPipeline(void);
+// Perfil
+void iniciarPerfil(void);
+void marcarFase(int fase);
+void fecharQuadroPerfil(void);
+void estatisticaFase(int fase, double *media, double *p99, double *maximo);
+int compararLongLong(const void *a, const void *b);
+int compararLong(const void *a, const void *b);
+void textoPerfil(char linhas[2][160]);
+void finalizarPerfil(void);
+// Gravação e replay
+void iniciarGravacao(void);
+void gravarPasso(unsigned acoes);
+void finalizarGravacao(void);
+void abrirReplay(const char *caminho);
+int lerPassoReplay(unsigned *acoes);
+// Aleatórios
+uint32_t rngProximo(Rng *r);
+void rngSemear(Rng *r, uint64_t s, uint64_t fluxo);
+int rngAte(Rng *r, int n);
+void semearAleatorios(Jogo *j, uint64_t s);
+// Headless
+void lerArgumentos(int argc, char **argv);
+unsigned entradaHeadless(Jogo *j, long n);
+int roteiroPedeVolta(void);
+// Lote
+int rodarLote(void);
+void *trabalharLote(void *arg);
+void jogarPartidaLote(Jogo *j, Piloto *pl, long k);
+long tirarDaFaixa(TrabalhadorLote *t);
+int roubarFaixa(TrabalhadorLote *vitima, uint32_t *inicio, uint32_t *fim);
+void imprimirDistribuicao(const char *nome, long *v, long n);
+// Relógio
+long long agoraNs(void);
+double agoraSegundos(void);
+void dormirAte(long long prazoNs);
+int rodarHeadless(void);
+// Piloto automático
+int iniciarPiloto(Piloto *pl);
+void semearPiloto(Piloto *pl, uint64_t s);
+void liberarPiloto(Piloto *pl);
+long valorDoEnsaio(Piloto *pl, const Jogo *j, unsigned acao);
+unsigned decidirPiloto(Piloto *pl, const Jogo *j);
+void resumoPiloto(const Piloto *pl);
+// Instantâneos e rebobinar
+size_t tamanhoInstantaneo(const Jogo *j);
+void salvarInstantaneo(Instantaneo *s, const Jogo *j);
+int restaurarInstantaneo(Jogo *j, const Instantaneo *s);
+int iniciarAnel(const Jogo *j);
+void esvaziarAnel(void);
+void liberarAnel(void);
+Instantaneo *instantaneoDoAnel(int k);
+void guardarNoAnel(const Jogo *j);
+void rebobinar(Jogo *j);
+void resumoAnel(void);
+// Placar
+size_t tamanhoPlacar(size_t cap);
+int abrirPlacar(const char *caminho);
+int mapearPlacar(size_t cap);
+int acompanharPlacar(void);
+void sincronizarPlacar(const void *inicio, size_t bytes);
+void marcarIndice(uint32_t emObra);
+void refazerIndice(void);
+int crescerPlacar(size_t precisa);
+void fecharPlacar(void);
+int compararPlacar(const void *a, const void *b);
+long ordenarDelta(void);
+void fundirDelta(void);
+long posicaoNoPlacar(int64_t score);
+void anexarNoPlacar(const RegistroPlacar *r, int n);
+int registrarNoPlacar(int64_t score, uint64_t s, long passo, unsigned origem);
+int tirarDoPlacar(RegistroPlacar *r);
+void *lacoPlacar(void *arg);
+void iniciarPlacar(void);
+void finalizarPlacar(void);
+int listarPlacar(long k);
+int benchPlacar(void);
+// Telemetria
+void emitirEvento(const Jogo *j, int tipo, int causa, int x, int y, long valor);
+int descarregarAnel(Telemetria *t);
+void *lacoDescarga(void *arg);
+void iniciarEventos(int nAneis);
+Telemetria *anelDeEventos(int i);
+void finalizarEventos(void);
+int lerEventos(const char *caminho);
+// Benchmarks
+int rodarBench(const char *nome);
+int benchNucleo(void);
+void criarRioInicial(Jogo *j);
+void gerarNovaLinhaNoTopo(Jogo *j);
+void gerarLinhaDoModelo(Jogo *j, LinhaRio *l);
+void gerarLoteDeTerreno(Jogo *j);
+LinhaRio tirarLinhaDaFila(Jogo *j);
+void recomecarRio(Jogo *j);
+int colunaDeRecomeco(const Jogo *j, int y);
+int aproximar(int valor, int alvo, int passo);
+int ehAgua(const LinhaRio *l, int x);
+int colunaLivre(Rng *r, const LinhaRio *l, int largura, int folga);
+LinhaRio *linhaDoRio(const Jogo *j, int y);
+void desenharTudo(const Jogo *j);
+void desenharInimigo(int ix, int iy);
+void alocarQuadros(int largura, int altura);
+void posicionarCamera(const Player *p);
+void liberarQuadros(void);
+void iniciarCores(void);
+void pintar(int y, int x, chtype c);
+void pintarFaixa(int y, int x0, int x1, chtype c);
+void pintarTexto(int y, int x, const char *texto, chtype atributos);
+void enviarQuadro(int rolar);
+void desenharAviao(const Player *p);
+int haColisao(const Jogo *j);
+void compilarMascaras(void);
+void ReiniciarInimigos(Jogo *j);
+void reiniciarVagas(ListaVagas *v, int capacidade);
+int pegarVaga(ListaVagas *v);
+void devolverVaga(ListaVagas *v, int i);
+// Entidades
+int alocarEntidades(Entidades *e, int capacidade);
+void liberarEntidades(Entidades *e);
+void reiniciarEntidades(Entidades *e);
+int estaVivo(const Entidades *e, int i);
+void nascer(Entidades *e, int i, int x, int y);
+void matar(Entidades *e, int i);
+void moverEntidades(Entidades *e);
+void reiniciarJogo(Jogo *j);
+// Tiros
+void iniciarBalas(Jogo *j);
+void disparar(Jogo *j);
+void atualizarBalas(Jogo *j);
+void indexarInimigos(Jogo *j);
+int inimigoEm(const Jogo *j, int x, int y);
+void desenharBalas(const int *x, const int *y, int n);
+// Gasolina
+void ReiniciarGasolina(Jogo *j);
 
 // ================================================================
-// BALAS
+// MAIN
 // ================================================================
-void iniciarBalas(void) { balas = NULL; }
-
-void destruirBalas(void)
+int main(int argc, char **argv)
 {
-    while (balas)
+    lerArgumentos(argc, argv);
+    compilarMascaras();
+    if (caminhoReplay)
+        abrirReplay(caminhoReplay);
+    if (!sementeDada)
+        semente = (uint64_t)time(NULL) ^ (uint64_t)agoraNs();
+
+    if (benchEscolhido)
+        return rodarBench(benchEscolhido);
+    if (topPlacar > 0)
+        return listarPlacar(topPlacar);
+    if (caminhoLerEventos)
+        return lerEventos(caminhoLerEventos);
+    iniciarPlacar();
+    if (nLote > 0)
+        return rodarLote();
+    if (modoHeadless)
+        return rodarHeadless();
+
+    iniciarNcurses();
+    iniciarGravacao();
+    iniciarEventos(1);
+    iniciarPerfil();
+
+    Jogo *j = &jogo;
+    j->eventos = anelDeEventos(0);
+    novaPartida(j, semente);
+    if (!iniciarAnel(j) || (pilotoLigado && !iniciarPiloto(&piloto)))
     {
-        Bala *tmp = balas;
-        balas = balas->prox;
-        free(tmp);
+        endwin();
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        return 1;
     }
-}
-
-void disparar(const Player *p)
-{
-    int narizX = p->x + AVIAO_W / 2;
-    int startY = p->y - 1;
-    if (startY <= 0)
-        return;
 
-    Bala *b = (Bala *)malloc(sizeof(Bala));
-    if (!b)
-        return;
-    b->x = narizX;
-    b->y = startY;
-    b->prox = balas;
-    balas = b;
-}
+    // Passo fixo: o mundo avança 1 passo a cada tick_usec de relógio
+    // monotônico, não importa quanto o desenho demore. O atraso acumulado
+    // é recuperado com até PASSOS_ATRASO_MAX passos seguidos por volta.
+    // Com --velocidade, o mesmo passo dura tick_usec / velocidade.
+    // Entre os passos o loop dorme em poll(): tecla que chega acorda na
+    // hora e fica guardada para o próximo passo.
+    // O desenho roda em outra thread (iniciarPipeline): aqui só se publica
+    // um retrato do mundo, então um terminal lento não atrasa os passos.
+    iniciarPipeline();
+    iniciarRelogioQuadro();
+    long long anterior = agoraNs();
+    long long acumulado = 0;
+    int fimDoReplay = 0;
 
-void atualizarBalas(Player *p)
-{
-    Bala **pp = &balas;
-    while (*pp)
+    while (!fimDoReplay)
     {
-        Bala *b = *pp;
-        b->y--;
+        long long agora = agoraNs();
+        if (drenarEntrada(&entrada))
+            break;
+        marcarFase(FASE_ENTRADA);
 
-        int remover = 0;
+        acumulado += agora - anterior;
+        anterior = agora;
+        long long tickNs = (long long)(j->tick_usec * 1000.0 / velocidade);
+        if (baixaLatencia && entrada.teclaNova && acumulado < tickNs)
+            acumulado = tickNs; // tecla nova: adianta o passo e a fase
 
-        if (b->y <= 0)
-        {
-            remover = 1;
-        }
-        else
+        int passos = 0;
+        while (acumulado >= tickNs && passos < PASSOS_ATRASO_MAX)
         {
-            if (b->x <= margemEsq[b->y] || b->x >= margemDir[b->y])
+            acumulado -= tickNs;
+            unsigned acoes = acoesDoPasso(&entrada, agoraNs());
+            if (pilotoLigado)
             {
-                remover = 1;
+                acoes = decidirPiloto(&piloto, j) | (acoes & ACAO_VOLTAR); // teclado: sair e voltar
+                marcarFase(FASE_PILOTO);
             }
-            else
+            if (arquivoReplay && !lerPassoReplay(&acoes))
             {
-                for (int i = 0; i < INIMIGOS_MAX; i++)
-                {
-                    if (inimigos[i].vivo &&
-                        b->x >= inimigos[i].x &&
-                        b->x < inimigos[i].x + INIMIGO_W &&
-                        b->y >= inimigos[i].y &&
-                        b->y < inimigos[i].y + INIMIGO_H)
-                    {
-                        inimigos[i].vivo = 0; // inimigo destruído
-                        p->score += 30;       // +30 pontos por abate
-                        remover = 1;          // bala se consome
-                        break;
-                    }
-                }
+                fimDoReplay = 1;
+                break;
             }
+            int estavaVivo = j->jogador.vivo;
+            passoDoJogo(j, acoes);
+            if (placarLigado && estavaVivo && !j->jogador.vivo &&
+                !registrarNoPlacar(j->jogador.score, semente, j->contadorLinha,
+                                   ORIGEM_TELA | (pilotoLigado ? ORIGEM_PILOTO : 0)))
+                atomic_fetch_add(&placar.perdidos, 1);
+            passos++;
         }
+        if (acumulado >= tickNs)
+            acumulado = 0; // atraso grande demais: descarta em vez de acelerar
 
-        if (remover)
-        {
-            *pp = b->prox;
-            free(b);
-        }
-        else
+        if (passos > 0)
         {
-            pp = &b->prox;
+            publicarRetrato(j);
+            marcarFase(FASE_PUBLICAR);
         }
+
+        // Prazo absoluto do próximo passo (o custo do desenho já está dentro)
+        esperarEvento(agora + tickNs - acumulado);
+        marcarFase(FASE_ESPERA);
+        if (passos > 0)
+            fecharQuadroPerfil();
+    }
+
+    finalizarRelogioQuadro();
+    finalizarPipeline();
+    finalizarGravacao();
+    finalizarNcurses();
+    finalizarPerfil();
+    finalizarPlacar();
+    finalizarEventos();
+    resumoAnel();
+    liberarAnel();
+    if (pilotoLigado)
+    {
+        resumoPiloto(&piloto);
+        liberarPiloto(&piloto);
     }
+    return 0;
 }
 
-void desenharBalas(void)
+// Passo do jogo que passa pelo gravador (--gravar) e pelo anel de
+// instantâneos (rebobinar)
+void passoDoJogo(Jogo *j, unsigned acoes)
 {
-    for (Bala *b = balas; b != NULL; b = b->prox)
+    // Sem anel não volta (gravar faria o replay voltar). Morto também não:
+    // a morte já foi para o placar e a telemetria, e voltar a morreria de novo
+    if (anel.cap == 0 || !j->jogador.vivo)
+        acoes &= ~ACAO_VOLTAR;
+    if (arquivoGravacao)
+        gravarPasso(acoes);
+    if (anel.cap > 0)
     {
-        mvaddch(b->y, b->x, '|');
+        marcarFase(FASE_ENTRADA);
+        if (acoes & ACAO_VOLTAR)
+        {
+            rebobinar(j); // o passo é só a volta
+            marcarFase(FASE_REBOBINAR);
+            return;
+        }
+        if (j->jogador.vivo)
+            guardarNoAnel(j); // morto, o estado não muda até o R
+        marcarFase(FASE_REBOBINAR);
     }
+    int estavaVivo = j->jogador.vivo;
+    atualizarJogo(j, acoes);
+    if (!estavaVivo && j->jogador.vivo)
+        esvaziarAnel(); // recomeçou: voltar nunca atravessa para a vida anterior
 }
 
-// ================================================================
-// NCURSES E RIO
-// ================================================================
-void iniciarNcurses(void)
+// Lê todas as teclas da fila. Esquerda/direita repetidas pelo
+// auto-repeat do terminal viram "segurada" por SEGURAR_NS; toque único
+// anda 1 passo. Tiro e reinício valem uma vez. Devolve 1 se pediu sair.
+int drenarEntrada(EstadoEntrada *e)
 {
-    initscr();
-    cbreak();
-    noecho();
-    curs_set(0);
-    keypad(stdscr, TRUE);
-    nodelay(stdscr, TRUE);
+    unsigned vistas = 0;
+    int velhas = 0;
+    int ch;
+    long long agora; // chegada da tecla (lida pela thread de desenho)
+    while (tirarTecla(&ch, &agora))
+    {
+        if (ch == 'q' || ch == 'Q')
+            return 1;
+        e->lidas++;
 
-    getmaxyx(stdscr, ALTURA, LARGURA);
+        unsigned a = teclaParaAcoes(ch);
+        if (a & vistas)
+            velhas++; // repetição já coberta neste quadro
+        vistas |= a;
+        if (a && e->chegada == 0)
+            e->chegada = agora;
+        for (int bit = 0; bit < 5; bit++)
+        {
+            if (!(a & (1u << bit)))
+                continue;
+            if (agora - e->ultimaTecla[bit] >= INTERVALO_AUTOREPEAT_NS)
+                e->teclaNova = 1;
+            if (bit >= 2)
+                e->ultimaTecla[bit] = agora; // direções atualizam abaixo
+        }
 
-    if (ALTURA < 20 || LARGURA < 40)
-    {
-        endwin();
-        fprintf(stderr, "Aumente o terminal para pelo menos 40x20.\n");
-        exit(1);
+        for (int lado = 0; lado < 2; lado++)
+        {
+            unsigned bit = lado == 0 ? ACAO_ESQ : ACAO_DIR;
+            unsigned oposto = lado == 0 ? ACAO_DIR : ACAO_ESQ;
+            if (!(a & bit))
+                continue;
+            if (agora - e->ultimaTecla[lado] < JANELA_REPETICAO_NS)
+                e->seguraAte[lado] = agora + SEGURAR_NS;
+            e->ultimaTecla[lado] = agora;
+            e->seguraAte[1 - lado] = 0; // a última direção apertada vence
+            e->pendentes &= ~oposto;
+        }
+        e->pendentes |= a;
     }
 
-    LARGURA_MIN = LARGURA / 3;
-    LARGURA_MAX = LARGURA / 2;
+    e->velhas += velhas;
+    if (velhas > e->maxVelhasQuadro)
+        e->maxVelhasQuadro = velhas;
+    return 0;
+}
 
-    margemEsq = (int *)malloc(sizeof(int) * ALTURA);
-    margemDir = (int *)malloc(sizeof(int) * ALTURA);
-    if (!margemEsq || !margemDir)
+// Ações do próximo passo: teclas pendentes + direções seguradas
+unsigned acoesDoPasso(EstadoEntrada *e, long long agora)
+{
+    if (e->chegada)
     {
-        endwin();
-        fprintf(stderr, "Falha ao alocar memória.\n");
-        exit(1);
+        long long atraso = agora - e->chegada;
+        amostrasAtraso[nAtrasos % AMOSTRAS_ATRASO] = atraso;
+        nAtrasos++;
+        somaAtraso += atraso;
+        if (atraso > maxAtraso)
+            maxAtraso = atraso;
+        e->chegada = 0;
     }
+    e->teclaNova = 0;
+
+    unsigned acoes = e->pendentes;
+    e->pendentes = 0;
+    if (e->seguraAte[0] > agora)
+        acoes |= ACAO_ESQ;
+    if (e->seguraAte[1] > agora)
+        acoes |= ACAO_DIR;
+    return acoes;
 }
 
-void finalizarNcurses(void)
+void iniciarRelogioQuadro(void)
 {
-    destruirBalas();
-    endwin();
-    free(margemEsq);
-    free(margemDir);
+#ifdef __linux__
+    relogioFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+#endif
 }
 
-void criarRioInicial(void)
+void finalizarRelogioQuadro(void)
 {
-    int centro = LARGURA / 2;
-    int larguraRio = LARGURA / 2;
-    if (larguraRio < LARGURA_MIN)
-        larguraRio = LARGURA_MIN;
-    if (larguraRio > LARGURA_MAX)
-        larguraRio = LARGURA_MAX;
+    if (relogioFd >= 0)
+        close(relogioFd);
+    relogioFd = -1;
+}
 
-    int metade = larguraRio / 2;
-    int L = centro - metade;
-    int R = centro + metade;
+// Dorme até o prazo absoluto ou até a thread de desenho avisar que
+// chegou tecla (1 = chegou). Com timerfd o prazo é exato; sem ele,
+// poll() em ms e o resto com dormirAte.
+int esperarEvento(long long prazoNs)
+{
+    if (prazoNs <= agoraNs())
+        return 0;
 
-    for (int y = 0; y < ALTURA; y++)
+    struct pollfd fds[2] = {{avisoTeclas[0], POLLIN, 0}, {relogioFd, POLLIN, 0}};
+    int r;
+#ifdef __linux__
+    if (relogioFd >= 0)
+    {
+        struct itimerspec quando = {{0, 0}, {prazoNs / 1000000000LL, prazoNs % 1000000000LL}};
+        timerfd_settime(relogioFd, TFD_TIMER_ABSTIME, &quando, NULL);
+        do
+            r = poll(fds, 2, -1);
+        while (r < 0 && errno == EINTR);
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t expiracoes;
+            if (read(relogioFd, &expiracoes, sizeof expiracoes) < 0)
+                expiracoes = 0;
+        }
+        if (r > 0 && (fds[0].revents & POLLIN))
+        {
+            esvaziarAviso(avisoTeclas[0]);
+            return 1;
+        }
+        return 0;
+    }
+#endif
+    int msFalta = (int)((prazoNs - agoraNs()) / 1000000);
+    r = poll(fds, 1, msFalta);
+    if (r > 0)
     {
-        margemEsq[y] = L;
-        margemDir[y] = R;
+        esvaziarAviso(avisoTeclas[0]);
+        return 1;
     }
+    dormirAte(prazoNs);
+    return 0;
 }
 
-void gerarNovaLinhaNoTopo(void)
+// Tecla do ncurses -> ações do jogo (bits ACAO_*)
+unsigned teclaParaAcoes(int ch)
 {
-    for (int y = ALTURA - 1; y > 0; y--)
+    if (ch == KEY_LEFT || ch == 'a' || ch == 'A')
+        return ACAO_ESQ;
+    if (ch == KEY_RIGHT || ch == 'd' || ch == 'D')
+        return ACAO_DIR;
+    if (ch == ' ')
+        return ACAO_TIRO;
+    if (ch == 'r' || ch == 'R')
+        return ACAO_REINICIAR;
+    if (ch == 'v' || ch == 'V' || ch == KEY_BACKSPACE)
+        return ACAO_VOLTAR;
+    return 0;
+}
+
+// ================================================================
+// PASSO DO JOGO (1 quadro de simulação, sem desenhar)
+// ================================================================
+void atualizarJogo(Jogo *j, unsigned acoes)
+{
+    Player *p = &j->jogador;
+    if (!p->vivo)
     {
-        margemEsq[y] = margemEsq[y - 1];
-        margemDir[y] = margemDir[y - 1];
+        if (acoes & ACAO_REINICIAR)
+            reiniciarJogo(j);
+        return;
     }
 
-    int Lant = margemEsq[0];
-    int Rant = margemDir[0];
-    int centroAnt = (Lant + Rant) / 2;
-    int larguraAnt = (Rant - Lant);
+    if (acoes & ACAO_ESQ)
+        p->x--;
+    if (acoes & ACAO_DIR)
+        p->x++;
+    if (acoes & ACAO_TIRO)
+        disparar(j);
 
-    int centroNovo = centroAnt + (rand() % 3 - 1);
-    int larguraNova = larguraAnt + (rand() % 3 - 1);
+    if (p->x < 1)
+        p->x = 1;
+    int maxX = LARGURA - AVIAO_W - 1;
+    if (p->x > maxX)
+        p->x = maxX;
+    marcarFase(FASE_ENTRADA);
 
-    if (larguraNova < LARGURA_MIN)
-        larguraNova = LARGURA_MIN;
-    if (larguraNova > LARGURA_MAX)
-        larguraNova = LARGURA_MAX;
+    j->contadorLinha++;
 
-    int metade = larguraNova / 2;
-    int Lnovo = centroNovo - metade;
-    int Rnovo = centroNovo + metade;
+    gerarNovaLinhaNoTopo(j);
+    marcarFase(FASE_RIO);
 
-    if (Lnovo < 1)
-    {
-        Lnovo = 1;
-        Rnovo = Lnovo + larguraNova;
-    }
-    if (Rnovo > LARGURA - 2)
+    moverEntidades(&j->inimigos);
+
+    j->contadorSpawn++;
+    if (j->contadorSpawn > j->limiteSpawn)
     {
-        Rnovo = LARGURA - 2;
-        Lnovo = Rnovo - larguraNova;
+        // Canal estreito demais para inimigo + avião: tenta na próxima linha
+        int x = colunaLivre(&j->rngInimigos, linhaDoRio(j, 0), INIMIGO_W, AVIAO_W + 2);
+        if (x >= 0)
+        {
+            j->contadorSpawn = 0;
+            int i = pegarVaga(&j->inimigos.vagas);
+            if (i >= 0)
+            {
+                nascer(&j->inimigos, i, x, 0);
+                emitirEvento(j, EVENTO_INIMIGO, 0, x, 0, 0);
+            }
+        }
     }
 
-    margemEsq[0] = Lnovo;
-    margemDir[0] = Rnovo;
-}
+    // ======== GASOLINA DESCENDO =========
+    moverEntidades(&j->postos);
 
-// ================================================================
-// DESENHO
-// ================================================================
-void desenharAviao(const Player *p)
-{
-    for (int r = 0; r < AVIAO_H; r++)
+    // ======== NASCER GASOLINA =========
+    // Sorteio de 3% ou posto planejado antes de um canal estreito
+    if (rngAte(&j->rngPostos, 100) < 3 || j->postoPlanejado)
     {
-        int y = p->y + r;
-        for (int c = 0; c < AVIAO_W; c++)
+        int x = colunaLivre(&j->rngPostos, linhaDoRio(j, 0), 6, 0); // "[FUEL]"
+        if (x >= 0)
         {
-            char ch = AVIAO[r][c];
-            if (ch == ' ')
-                continue;
-            int x = p->x + c;
-            mvaddch(y, x, p->vivo ? ch : 'X');
+            j->postoPlanejado = 0;
+            int i = pegarVaga(&j->postos.vagas);
+            if (i >= 0)
+            {
+                nascer(&j->postos, i, x, 0);
+                emitirEvento(j, EVENTO_POSTO, 0, x, 0, 0);
+            }
         }
     }
-}
 
-void desenharInimigo(const Inimigo *in)
+    indexarInimigos(j);
+    marcarFase(FASE_ENTIDADES);
+    atualizarBalas(j);
+    marcarFase(FASE_BALAS);
 
-{
-    for (int r = 0; r < INIMIGO_H; r++)
+    if (j->contadorLinha % 100 == 0)
     {
-        int y = in->y + r;
-        if (y < 0 || y >= ALTURA)
-            continue;
+        p->score += 10; // 10 Pontos por tempo sobrevivido
+    }
 
-        for (int c = 0; c < INIMIGO_W; c++)
+    if (j->contadorLinha % 120 == 0 && j->tick_usec > TICK_MIN_USEC)
+    {
+        j->tick_usec -= 2000; // acelera um pouquinho
+        if (j->tick_usec < TICK_MIN_USEC)
+            j->tick_usec = TICK_MIN_USEC;
+        emitirEvento(j, EVENTO_ACELERA, 0, p->x, p->y, j->tick_usec);
+    }
+
+    if (j->contadorLinha % 500 == 0 && j->limiteSpawn > 3)
+        j->limiteSpawn--;
+
+    // Coleta gasolina
+    for (int w = 0; w < j->postos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->postos.vivo[w]; bits; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            if (j->postos.x[i] >= p->x &&
+                j->postos.x[i] < p->x + AVIAO_W &&
+                j->postos.y[i] >= p->y &&
+                j->postos.y[i] < p->y + AVIAO_H)
+            {
+                emitirEvento(j, EVENTO_COLETA, 0, j->postos.x[i], j->postos.y[i], p->fuel);
+                matar(&j->postos, i);
+                p->fuel = 100;
+            }
+        }
+    }
+    marcarFase(FASE_COLETA);
+
+    // Consome combustível
+    j->fuelTick++;
+    if (j->fuelTick >= 8) // gasta 1 unidade a cada 8 ciclos
+    {
+        j->fuelTick = 0;
+        p->fuel--;
+    }
+    // A colisão vale como causa mesmo se o combustível acabou junto
+    int causa = haColisao(j);
+    if (!causa && p->fuel <= 0)
+        causa = CAUSA_COMBUSTIVEL;
+    if (causa)
+    {
+        p->vivo = 0;
+        emitirEvento(j, EVENTO_MORTE, causa, p->x, p->y, p->score);
+    }
+    marcarFase(FASE_COLISAO);
+}
+
+// ================================================================
+// MODO HEADLESS (sem ncurses, sem espera: mede quadros por segundo)
+// ================================================================
+void lerArgumentos(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *valor = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--headless") == 0)
+        {
+            modoHeadless = 1;
+        }
+        else if (strcmp(arg, "--largura") == 0 && valor)
+        {
+            LARGURA = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--altura") == 0 && valor)
+        {
+            ALTURA = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--mundo") == 0 && valor)
+        {
+            if (sscanf(valor, "%dx%d", &LARGURA, &ALTURA) != 2)
+            {
+                fprintf(stderr, "--mundo espera LARGURAxALTURA (ex.: 300x60).\n");
+                exit(1);
+            }
+            mundoDado = 1;
+            i++;
+        }
+        else if (strcmp(arg, "--quadros") == 0 && valor)
+        {
+            quadrosHeadless = atol(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--roteiro") == 0 && valor)
+        {
+            roteiroEntrada = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--inimigos") == 0 && valor)
+        {
+            capInimigos = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--postos") == 0 && valor)
+        {
+            capPostos = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--seed") == 0 && valor)
+        {
+            semente = strtoull(valor, NULL, 10);
+            sementeDada = 1;
+            i++;
+        }
+        else if (strcmp(arg, "--cadencia") == 0 && valor)
+        {
+            cadenciaTiro = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--bench") == 0 && valor)
+        {
+            benchEscolhido = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--base") == 0 && valor)
+        {
+            caminhoBase = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--gravar") == 0 && valor)
+        {
+            caminhoGravacao = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--replay") == 0 && valor)
+        {
+            caminhoReplay = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--velocidade") == 0 && valor)
+        {
+            velocidade = atof(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--baixa-latencia") == 0)
+        {
+            baixaLatencia = 1;
+        }
+        else if (strcmp(arg, "--piloto") == 0)
+        {
+            pilotoLigado = 1;
+        }
+        else if (strcmp(arg, "--lote") == 0 && valor)
+        {
+            nLote = atol(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--threads") == 0 && valor)
+        {
+            threadsLote = atoi(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--placar") == 0 && valor)
+        {
+            caminhoPlacar = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--placar-top") == 0 && valor)
+        {
+            topPlacar = atol(valor);
+            i++;
+        }
+        else if (strcmp(arg, "--eventos") == 0 && valor)
+        {
+            caminhoEventos = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--ler-eventos") == 0 && valor)
+        {
+            caminhoLerEventos = valor;
+            i++;
+        }
+        else if (strcmp(arg, "--perfil") == 0)
+        {
+            perfilLigado = 1;
+        }
+        else if (strcmp(arg, "--perfil-csv") == 0 && valor)
+        {
+            perfilLigado = 1;
+            caminhoPerfilCsv = valor;
+            i++;
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Uso: %s [--headless] [--largura N] [--altura N] [--mundo LxA]\n"
+                    "          [--quadros N] [--roteiro TECLAS] [--cadencia N]\n"
+                    "          [--inimigos N] [--postos N] [--seed N]\n"
+                    "          [--gravar ARQ] [--replay ARQ] [--velocidade F]\n"
+                    "          [--perfil] [--perfil-csv ARQ] [--baixa-latencia]\n"
+                    "          [--lote N] [--threads N] [--piloto]\n"
+                    "          [--placar ARQ] [--placar-top K]\n"
+                    "          [--eventos ARQ] [--ler-eventos ARQ]\n"
+                    "          [--bench render|balas|entidades|nucleo|placar] [--base ARQ]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+
+    if (quadrosHeadless < 1)
+    {
+        fprintf(stderr, "--quadros precisa ser pelo menos 1.\n");
+        exit(1);
+    }
+    if (capInimigos < 1 || capPostos < 1)
+    {
+        fprintf(stderr, "--inimigos e --postos precisam ser pelo menos 1.\n");
+        exit(1);
+    }
+    if (mundoDado && (LARGURA < 40 || ALTURA < 20))
+    {
+        fprintf(stderr, "O mundo precisa ter pelo menos 40x20.\n");
+        exit(1);
+    }
+    // x/y de inimigos e postos são int16_t (ver Entidades)
+    if (LARGURA < 0 || ALTURA < 0 || LARGURA > INT16_MAX || ALTURA > INT16_MAX)
+    {
+        fprintf(stderr, "Largura e altura vão até %d.\n", INT16_MAX);
+        exit(1);
+    }
+    if (cadenciaTiro < 1)
+    {
+        fprintf(stderr, "--cadencia precisa ser pelo menos 1.\n");
+        exit(1);
+    }
+    if (velocidade <= 0)
+    {
+        fprintf(stderr, "--velocidade precisa ser maior que 0.\n");
+        exit(1);
+    }
+    if (caminhoGravacao && caminhoReplay)
+    {
+        fprintf(stderr, "--gravar e --replay não podem ser usados juntos.\n");
+        exit(1);
+    }
+    if (nLote < 0 || nLote > UINT32_MAX || threadsLote < 0)
+    {
+        fprintf(stderr, "--lote e --threads precisam ser positivos.\n");
+        exit(1);
+    }
+    if (pilotoLigado && caminhoReplay)
+    {
+        fprintf(stderr, "--piloto e --replay não podem ser usados juntos.\n");
+        exit(1);
+    }
+    if (caminhoPlacar && caminhoReplay)
+    {
+        fprintf(stderr, "--placar e --replay não podem ser usados juntos (o replay já está no placar).\n");
+        exit(1);
+    }
+    if (topPlacar < 0 || (topPlacar > 0 && !caminhoPlacar))
+    {
+        fprintf(stderr, "--placar-top K precisa de K positivo e de --placar ARQ.\n");
+        exit(1);
+    }
+    if (nLote > 0 && (caminhoGravacao || caminhoReplay || perfilLigado))
+    {
+        fprintf(stderr, "--lote não combina com --gravar, --replay nem --perfil.\n");
+        exit(1);
+    }
+}
+
+// O --roteiro tem alguma tecla de voltar? (aí o headless precisa do anel)
+int roteiroPedeVolta(void)
+{
+    for (const char *c = roteiroEntrada; c && *c; c++)
+        if (*c != '.' && (teclaParaAcoes(*c) & ACAO_VOLTAR))
+            return 1;
+    return 0;
+}
+
+// Tecla do quadro n: segue o roteiro (em ciclo) ou sorteia uma
+unsigned entradaHeadless(Jogo *j, long n)
+{
+    if (roteiroEntrada && roteiroEntrada[0])
+    {
+        char c = roteiroEntrada[n % (long)strlen(roteiroEntrada)];
+        return c == '.' ? 0 : teclaParaAcoes(c); // '.' = nenhuma tecla
+    }
+
+    int sorteio = rngAte(&j->rngEntrada, 10);
+    if (sorteio < 2)
+        return ACAO_ESQ;
+    if (sorteio < 4)
+        return ACAO_DIR;
+    if (sorteio < 5)
+        return ACAO_TIRO;
+    return 0;
+}
+
+// ================================================================
+// NÚMEROS ALEATÓRIOS (PCG32)
+// ----------------------------------------------------------------
+// Gerador pequeno e rápido, sem estado global escondido. Cada parte do
+// jogo tem seu próprio fluxo, todos derivados da mesma semente (--seed):
+// mudar quantos sorteios o terreno faz não altera inimigos nem postos.
+// ================================================================
+uint32_t rngProximo(Rng *r)
+{
+    uint64_t antigo = r->estado;
+    r->estado = antigo * 6364136223846793005ULL + r->inc;
+    uint32_t xorDeslocado = (uint32_t)(((antigo >> 18) ^ antigo) >> 27);
+    uint32_t rotacao = (uint32_t)(antigo >> 59);
+    return (xorDeslocado >> rotacao) | (xorDeslocado << ((-rotacao) & 31));
+}
+
+void rngSemear(Rng *r, uint64_t s, uint64_t fluxo)
+{
+    r->estado = 0;
+    r->inc = (fluxo << 1) | 1u; // incremento ímpar escolhe o fluxo
+    rngProximo(r);
+    r->estado += s;
+    rngProximo(r);
+}
+
+// Inteiro em [0, n) (multiplicação em vez de %, n > 0)
+int rngAte(Rng *r, int n)
+{
+    return (int)(((uint64_t)rngProximo(r) * (uint32_t)n) >> 32);
+}
+
+void semearAleatorios(Jogo *j, uint64_t s)
+{
+    rngSemear(&j->rngTerreno, s, 1);
+    rngSemear(&j->rngInimigos, s, 2);
+    rngSemear(&j->rngPostos, s, 3);
+    rngSemear(&j->rngEntrada, s, 4);
+}
+
+// ================================================================
+// RELÓGIO MONOTÔNICO
+// ================================================================
+long long agoraNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+double agoraSegundos(void)
+{
+    return agoraNs() / 1e9;
+}
+
+// Dorme até o instante absoluto 'prazoNs' (sem acumular deriva)
+void dormirAte(long long prazoNs)
+{
+#ifdef __APPLE__
+    long long falta = prazoNs - agoraNs(); // macOS não tem clock_nanosleep
+    if (falta <= 0)
+        return;
+    struct timespec ts = {falta / 1000000000LL, falta % 1000000000LL};
+    nanosleep(&ts, NULL);
+#else
+    struct timespec ts = {prazoNs / 1000000000LL, prazoNs % 1000000000LL};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ; // acordou por sinal (ex.: redimensionar): volta a dormir
+#endif
+}
+
+int rodarHeadless(void)
+{
+    if (LARGURA == 0)
+        LARGURA = 80;
+    if (ALTURA == 0)
+        ALTURA = 24;
+    if (ALTURA < 20 || LARGURA < 40)
+    {
+        fprintf(stderr, "O campo virtual precisa ter pelo menos 40x20.\n");
+        return 1;
+    }
+    alocarMundo();
+    iniciarGravacao();
+    iniciarEventos(1);
+    iniciarPerfil();
+
+    Jogo *j = &jogo;
+    const Player *p = &j->jogador;
+    j->eventos = anelDeEventos(0);
+    novaPartida(j, semente);
+    // Sem tela, só o replay e um roteiro com 'v' podem pedir para voltar
+    if (((arquivoReplay || roteiroPedeVolta()) && !iniciarAnel(j)) || (pilotoLigado && !iniciarPiloto(&piloto)))
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        return 1;
+    }
+
+    long mortes = 0;
+    long melhorScore = 0;
+    long reinicios = 0; // passos de recomeço lidos do replay
+    double inicio = agoraSegundos();
+
+    // Replay: roda até o fim do arquivo (os reinícios estão gravados)
+    long limite = arquivoReplay ? LONG_MAX : quadrosHeadless;
+    long n;
+    for (n = 0; n < limite; n++)
+    {
+        unsigned acoes;
+        if (arquivoReplay)
+        {
+            if (!lerPassoReplay(&acoes))
+                break;
+        }
+        else if (pilotoLigado)
+        {
+            acoes = decidirPiloto(&piloto, j);
+            marcarFase(FASE_PILOTO);
+        }
+        else
+        {
+            acoes = entradaHeadless(j, n);
+        }
+
+        int estavaVivo = p->vivo;
+        passoDoJogo(j, acoes);
+        if (arquivoReplay && !estavaVivo)
+            reinicios++; // na gravação o recomeço vai junto com o quadro da morte
+
+        if (estavaVivo && !p->vivo)
+        {
+            mortes++;
+            if (p->score > melhorScore)
+                melhorScore = p->score;
+            if (placarLigado &&
+                !registrarNoPlacar(p->score, semente, j->contadorLinha,
+                                   ORIGEM_HEADLESS | (pilotoLigado ? ORIGEM_PILOTO : 0)))
+                atomic_fetch_add(&placar.perdidos, 1);
+        }
+        if (!p->vivo && !arquivoReplay && n + 1 < limite)
+            passoDoJogo(j, ACAO_REINICIAR); // recomeça na hora
+        if (perfilLigado)
+            fecharQuadroPerfil();
+    }
+
+    double duracao = agoraSegundos() - inicio;
+    if (p->score > melhorScore)
+        melhorScore = p->score;
+    finalizarGravacao();
+
+    n -= reinicios;
+    printf("headless %dx%d semente %llu: %ld quadros em %.3f s (%.0f quadros/s)\n",
+           LARGURA, ALTURA, (unsigned long long)semente, n, duracao,
+           duracao > 0 ? n / duracao : 0.0);
+    printf("final: score %ld  fuel %d  %s | mortes %ld  melhor score %ld\n",
+           p->score, p->fuel, p->vivo ? "vivo" : "morto",
+           mortes, melhorScore);
+    printf("spawns recusados (sem vaga): inimigos %ld/%d  postos %ld/%d\n",
+           j->inimigos.vagas.rejeitados, capInimigos, j->postos.vagas.rejeitados, capPostos);
+    resumoAnel();
+    liberarAnel();
+    if (pilotoLigado)
+    {
+        resumoPiloto(&piloto);
+        liberarPiloto(&piloto);
+    }
+    finalizarPerfil();
+    finalizarPlacar();
+    finalizarEventos();
+
+    liberarMundo();
+    return 0;
+}
+
+// ================================================================
+// BALAS
+// ================================================================
+void iniciarBalas(Jogo *j)
+{
+    j->nBalas = 0;
+    j->ultimoTiro = -1000000;
+}
+
+void disparar(Jogo *j)
+{
+    const Player *p = &j->jogador;
+    int narizX = p->x + AVIAO_W / 2;
+    int startY = p->y - 1;
+    if (startY <= 0)
+        return;
+
+    // Limite de cadência e de capacidade (tecla repetida não acumula)
+    if (j->contadorLinha - j->ultimoTiro < cadenciaTiro || j->nBalas == BALAS_MAX)
+        return;
+    j->ultimoTiro = j->contadorLinha;
+
+    j->balaX[j->nBalas] = narizX;
+    j->balaY[j->nBalas] = startY;
+    j->nBalas++;
+}
+
+void atualizarBalas(Jogo *j)
+{
+    int b = 0;
+    while (b < j->nBalas)
+    {
+        int x = j->balaX[b];
+        int y = --j->balaY[b];
+
+        int remover = 0;
+
+        if (y <= 0)
+        {
+            remover = 1;
+        }
+        else
+        {
+            if (!ehAgua(linhaDoRio(j, y), x))
+            {
+                remover = 1; // bateu na margem ou numa ilha
+            }
+            else
+            {
+                int i = inimigoEm(j, x, y);
+                if (i >= 0)
+                {
+                    matar(&j->inimigos, i); // inimigo destruído
+                    j->jogador.score += 30; // +30 pontos por abate
+                    remover = 1;            // bala se consome
+                    emitirEvento(j, EVENTO_ABATE, 0, x, y, j->jogador.score);
+                }
+            }
+        }
+
+        if (remover)
+        {
+            // Remoção O(1): a última bala vem para a posição b
+            j->nBalas--;
+            j->balaX[b] = j->balaX[j->nBalas];
+            j->balaY[b] = j->balaY[j->nBalas];
+        }
+        else
+        {
+            b++;
+        }
+    }
+}
+
+// Refaz o índice de inimigos por linha (ordenação por contagem)
+void indexarInimigos(Jogo *j)
+{
+    memset(j->inicioLinha, 0, sizeof(int) * (ALTURA + 1));
+    for (int w = 0; w < j->inimigos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->inimigos.vivo[w]; bits; bits &= bits - 1)
+            j->inicioLinha[j->inimigos.y[w * 64 + __builtin_ctzll(bits)] + 1]++;
+    }
+    for (int y = 0; y < ALTURA; y++)
+        j->inicioLinha[y + 1] += j->inicioLinha[y];
+
+    // Coloca cada inimigo no seu balde; inicioLinha[y] anda até o fim do balde
+    for (int w = 0; w < j->inimigos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->inimigos.vivo[w]; bits; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            j->inimigosPorLinha[j->inicioLinha[j->inimigos.y[i]]++] = i;
+        }
+    }
+    // ... e volta uma posição para ser de novo o início
+    for (int y = ALTURA; y > 0; y--)
+        j->inicioLinha[y] = j->inicioLinha[y - 1];
+    j->inicioLinha[0] = 0;
+}
+
+// Inimigo vivo que cobre a célula (x, y), ou -1. Só olha os baldes das
+// INIMIGO_H linhas de topo que podem alcançar y. Entre vários, devolve o
+// de menor índice (como a busca linear antiga).
+int inimigoEm(const Jogo *j, int x, int y)
+{
+    int y0 = y - INIMIGO_H + 1;
+    if (y0 < 0)
+        y0 = 0;
+    if (y >= ALTURA)
+        y = ALTURA - 1;
+
+    int achado = -1;
+    for (int k = j->inicioLinha[y0]; k < j->inicioLinha[y + 1]; k++)
+    {
+        int i = j->inimigosPorLinha[k];
+        if (estaVivo(&j->inimigos, i) &&
+            x >= j->inimigos.x[i] &&
+            x < j->inimigos.x[i] + INIMIGO_W &&
+            (achado < 0 || i < achado))
+            achado = i;
+    }
+    return achado;
+}
+
+void desenharBalas(const int *x, const int *y, int n)
+{
+    for (int b = 0; b < n; b++)
+    {
+        pintar(y[b] - cameraY, x[b] - cameraX, '|' | COLOR_PAIR(2));
+    }
+}
+
+// ================================================================
+// NCURSES E RIO
+// ================================================================
+void iniciarNcurses(void)
+{
+    initscr();
+    cbreak();
+    noecho();
+    curs_set(0);
+    keypad(stdscr, TRUE);
+    nodelay(stdscr, TRUE);
+    scrollok(stdscr, TRUE); // permite scrl() para rolar o rio
+    idlok(stdscr, TRUE);    // usa inserir/apagar linha do terminal
+    iniciarCores();
+
+    int largura, altura;
+    getmaxyx(stdscr, altura, largura);
+
+    if (altura < 20 || largura < 40)
+    {
+        endwin();
+        fprintf(stderr, "Aumente o terminal para pelo menos 40x20.\n");
+        exit(1);
+    }
+    if (!mundoDado)
+    {
+        LARGURA = largura; // sem --mundo, o mundo tem o tamanho da tela
+        ALTURA = altura;
+    }
+
+    alocarMundo();
+    alocarQuadros(largura, altura);
+}
+
+// Limites do rio e a partida principal (usado com e sem ncurses)
+void alocarMundo(void)
+{
+    definirLimitesDoRio();
+    if (!alocarJogo(&jogo))
+    {
+        if (!modoHeadless)
+            endwin();
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+}
+
+void definirLimitesDoRio(void)
+{
+    LARGURA_MIN = AVIAO_W + 4;
+    LARGURA_MAX = LARGURA - 4;
+}
+
+// Os vetores de uma partida (margens, índice e entidades) ficam numa
+// arena só, então copiar a partida inteira são dois memcpy (copiarJogo).
+// 0 se faltou memória.
+int alocarJogo(Jogo *j)
+{
+    j->tamArena = apontarArena(j, NULL);
+    char *arena = (char *)aligned_alloc(64, j->tamArena);
+    if (!arena)
+        return 0;
+    memset(arena, 0, j->tamArena);
+    apontarArena(j, arena);
+    j->topoRio = 0;
+    j->filaRioN = 0; // mundo novo: o primeiro reiniciarJogo cria o rio do zero
+    j->inimigos.vagas.rejeitados = j->postos.vagas.rejeitados = 0;
+    return 1;
+}
+
+// Pedaço de 'bytes' da arena, alinhado a 64; com arena NULL só conta
+void *pedacoDaArena(char *arena, size_t *usado, size_t bytes)
+{
+    void *p = arena ? arena + *usado : NULL;
+    *usado += (bytes + 63) & ~(size_t)63;
+    return p;
+}
+
+void apontarEntidades(Entidades *e, char *arena, size_t *usado, int capacidade)
+{
+    e->cap = capacidade;
+    e->nPalavras = (capacidade + 63) / 64;
+    size_t vagas = (size_t)e->nPalavras * 64; // folga até múltiplo de 64
+    e->x = (int16_t *)pedacoDaArena(arena, usado, sizeof(int16_t) * vagas);
+    e->y = (int16_t *)pedacoDaArena(arena, usado, sizeof(int16_t) * vagas);
+    e->vivo = (uint64_t *)pedacoDaArena(arena, usado, sizeof(uint64_t) * e->nPalavras);
+    e->vagas.livres = (int *)pedacoDaArena(arena, usado, sizeof(int) * capacidade);
+}
+
+// Aponta os vetores da partida para dentro da arena; devolve o tamanho
+size_t apontarArena(Jogo *j, char *arena)
+{
+    size_t usado = 0;
+    j->arena = arena;
+    j->rio = (LinhaRio *)pedacoDaArena(arena, &usado, sizeof(LinhaRio) * ALTURA);
+    j->inicioLinha = (int *)pedacoDaArena(arena, &usado, sizeof(int) * (ALTURA + 1));
+    j->inimigosPorLinha = (int *)pedacoDaArena(arena, &usado, sizeof(int) * capInimigos);
+    // Entidades: capacidades vêm da linha de comando (--inimigos/--postos)
+    apontarEntidades(&j->inimigos, arena, &usado, capInimigos);
+    apontarEntidades(&j->postos, arena, &usado, capPostos);
+    return usado;
+}
+
+// Copia a partida src para dst (já alocada com alocarJogo): o struct e a
+// arena de uma vez, e os ponteiros voltam para a arena de dst (o anel
+// de eventos também continua o de dst)
+void copiarJogo(Jogo *dst, const Jogo *src)
+{
+    char *arena = dst->arena;
+    Telemetria *eventos = dst->eventos; // o ensaio do piloto não registra nada
+    memcpy(dst, src, sizeof *dst);
+    memcpy(arena, src->arena, src->tamArena);
+    apontarArena(dst, arena);
+    dst->eventos = eventos;
+}
+
+void finalizarNcurses(void)
+{
+    endwin();
+    long rejeitados = jogo.inimigos.vagas.rejeitados + jogo.postos.vagas.rejeitados;
+    liberarMundo();
+    liberarQuadros();
+
+    if (rejeitados > 0)
+        printf("spawns recusados (sem vaga): %ld\n", rejeitados);
+
+    printf("semente: %llu (repita com --seed)\n", (unsigned long long)semente);
+    if (entrada.lidas > 0)
+        printf("entrada: %ld teclas lidas, %ld repeticoes descartadas (max %d num quadro)\n",
+               entrada.lidas, entrada.velhas, entrada.maxVelhasQuadro);
+    if (nAtrasos > 0)
+    {
+        int n = nAtrasos < AMOSTRAS_ATRASO ? (int)nAtrasos : AMOSTRAS_ATRASO;
+        qsort(amostrasAtraso, n, sizeof amostrasAtraso[0], compararLongLong);
+        printf("atraso tecla->passo%s: media %.1f ms  p99 %.1f ms  max %.1f ms (%ld passos com tecla)\n",
+               baixaLatencia ? " (baixa latencia)" : "",
+               somaAtraso / 1e6 / nAtrasos, amostrasAtraso[(n * 99) / 100] / 1e6,
+               maxAtraso / 1e6, nAtrasos);
+    }
+    if (quadrosDesenhados > 0)
+        printf("desenho: %.1f celulas/quadro em media (tela %dx%d = %d, mundo %dx%d)\n",
+               (double)celulasTotal / quadrosDesenhados,
+               larguraTela, alturaTela, larguraTela * alturaTela, LARGURA, ALTURA);
+    if (retratosPublicados > 0)
+        printf("pipeline: %ld retratos publicados, %ld desenhados (%ld pulados), desenho %.0f us em media%s\n",
+               retratosPublicados, retratosDesenhados, retratosPublicados - retratosDesenhados,
+               retratosDesenhados ? somaDesenhoNs / 1e3 / retratosDesenhados : 0.0,
+               teclasPerdidas ? " (fila de teclas transbordou)" : "");
+}
+
+void liberarMundo(void)
+{
+    liberarJogo(&jogo);
+}
+
+void liberarJogo(Jogo *j)
+{
+    free(j->arena);
+    j->arena = NULL;
+}
+
+void criarRioInicial(Jogo *j)
+{
+    int centro = LARGURA / 2;
+    int larguraRio = LARGURA / 2;
+    if (larguraRio < LARGURA_MIN)
+        larguraRio = LARGURA_MIN;
+    if (larguraRio > LARGURA_MAX)
+        larguraRio = LARGURA_MAX;
+
+    int metade = larguraRio / 2;
+    int L = centro - metade;
+    int R = centro + metade;
+
+    j->topoRio = 0;
+    for (int y = 0; y < ALTURA; y++)
+    {
+        LinhaRio reta = {L, R, 0, 0, SECAO_RETA, 0};
+        j->rio[y] = reta;
+    }
+
+    // Começa por uma reta, continuando a linha do topo
+    j->gerador.posCiclo = 0;
+    j->gerador.restantes = modelosSecao[SECAO_RETA].compMin;
+    j->gerador.centro = (L + R) / 2;
+    j->gerador.largura = j->gerador.alvoLargura = R - L;
+    j->gerador.ilha = j->gerador.alvoIlha = 0;
+    j->filaRioInicio = j->filaRioN = 0;
+    j->postoPlanejado = 0;
+    gerarLoteDeTerreno(j);
+}
+
+// Anda 'passo' em direção a 'alvo' sem passar dele
+int aproximar(int valor, int alvo, int passo)
+{
+    if (valor < alvo)
+        return valor + passo < alvo ? valor + passo : alvo;
+    if (valor > alvo)
+        return valor - passo > alvo ? valor - passo : alvo;
+    return valor;
+}
+
+// Uma linha da seção atual: largura e ilha seguem o modelo (cada margem
+// anda no máximo 1 coluna por linha) e o centro faz passeio aleatório
+void gerarLinhaDoModelo(Jogo *j, LinhaRio *l)
+{
+    GeradorRio *g = &j->gerador;
+    int inicio = 0;
+    if (g->restantes <= 0)
+    {
+        g->posCiclo = (g->posCiclo + 1) % NCICLO;
+        const ModeloSecao *m = &modelosSecao[cicloSecoes[g->posCiclo]];
+        g->restantes = m->compMin + rngAte(&j->rngTerreno, m->compMax - m->compMin + 1);
+        g->alvoLargura = LARGURA * m->larguraPct / 100;
+        if (g->alvoLargura < LARGURA_MIN)
+            g->alvoLargura = LARGURA_MIN;
+        if (g->alvoLargura > LARGURA_MAX)
+            g->alvoLargura = LARGURA_MAX;
+        g->alvoIlha = g->alvoLargura * m->ilhaPct / 100;
+        inicio = 1;
+    }
+    int secao = cicloSecoes[g->posCiclo];
+
+    g->largura = aproximar(g->largura, g->alvoLargura, 2);
+
+    // A ilha cresce com o rio e fecha antes do fim da seção; cada canal
+    // ao lado dela mantém pelo menos LARGURA_MIN
+    int alvoIlha = g->alvoIlha;
+    if (g->restantes * 2 <= g->ilha)
+        alvoIlha = 0;
+    int ilhaMax = g->largura - 2 * LARGURA_MIN;
+    if (alvoIlha > ilhaMax)
+        alvoIlha = ilhaMax > 0 ? ilhaMax : 0;
+    g->ilha = aproximar(g->ilha, alvoIlha, 2);
+    if (g->ilha > ilhaMax)
+        g->ilha = ilhaMax > 0 ? ilhaMax : 0;
+
+    g->centro += rngAte(&j->rngTerreno, 3) - 1;
+    int metade = g->largura / 2;
+    if (g->centro - metade < 1)
+        g->centro = 1 + metade;
+    if (g->centro - metade + g->largura > LARGURA - 2)
+        g->centro = LARGURA - 2 - g->largura + metade;
+
+    l->esq = g->centro - metade;
+    l->dir = l->esq + g->largura;
+    l->ilhaEsq = g->centro - g->ilha / 2;
+    l->ilhaDir = l->ilhaEsq + g->ilha;
+    l->secao = (unsigned char)secao;
+    l->inicioSecao = (unsigned char)inicio;
+    g->restantes--;
+}
+
+// Completa a fila de uma vez, em vez de 1 linha por quadro
+void gerarLoteDeTerreno(Jogo *j)
+{
+    while (j->filaRioN < LOOKAHEAD_LINHAS)
+    {
+        int fim = (j->filaRioInicio + j->filaRioN) % LOOKAHEAD_LINHAS;
+        gerarLinhaDoModelo(j, &j->filaRio[fim]);
+        j->filaRioN++;
+    }
+}
+
+// Próxima linha pronta; completa a fila quando a folga cai de um lote
+LinhaRio tirarLinhaDaFila(Jogo *j)
+{
+    if (j->filaRioN < LOOKAHEAD_LINHAS - LOTE_TERRENO)
+        gerarLoteDeTerreno(j);
+    LinhaRio l = j->filaRio[j->filaRioInicio];
+    j->filaRioInicio = (j->filaRioInicio + 1) % LOOKAHEAD_LINHAS;
+    j->filaRioN--;
+    return l;
+}
+
+void gerarNovaLinhaNoTopo(Jogo *j)
+{
+    // A linha mais antiga (fundo da tela) vira o novo topo
+    j->topoRio = (j->topoRio == 0) ? ALTURA - 1 : j->topoRio - 1;
+    j->rio[j->topoRio] = tirarLinhaDaFila(j);
+    j->linhasRoladas++;
+
+    // Canal estreito chegando: garante um posto de gasolina antes dele
+    const LinhaRio *aFrente = &j->filaRio[(j->filaRioInicio + ANTECEDENCIA_POSTO - 1) % LOOKAHEAD_LINHAS];
+    if (aFrente->inicioSecao && aFrente->secao == SECAO_CANAL)
+        j->postoPlanejado = 1;
+}
+
+// Depois de morrer, o rio continua (como no Atari, que volta na última
+// ponte): pula até o começo da próxima reta e enche a tela a partir dela.
+// Refazer a fila inteira a cada morte custaria centenas de linhas.
+void recomecarRio(Jogo *j)
+{
+    while (!(j->filaRio[j->filaRioInicio].inicioSecao && j->filaRio[j->filaRioInicio].secao == SECAO_RETA))
+        tirarLinhaDaFila(j);
+    for (int y = 0; y < ALTURA; y++)
+        gerarNovaLinhaNoTopo(j);
+    j->postoPlanejado = 0;
+}
+
+// Coluna do avião no recomeço: meio do canal mais largo da sua linha
+int colunaDeRecomeco(const Jogo *j, int y)
+{
+    const LinhaRio *l = linhaDoRio(j, y);
+    int a = l->esq + 1, b = l->dir;
+    if (l->ilhaDir > l->ilhaEsq)
+    {
+        if (l->ilhaEsq - a >= b - l->ilhaDir)
+            b = l->ilhaEsq;
+        else
+            a = l->ilhaDir;
+    }
+    return (a + b) / 2 - AVIAO_W / 2;
+}
+
+int ehAgua(const LinhaRio *l, int x)
+{
+    return x > l->esq && x < l->dir && (x < l->ilhaEsq || x >= l->ilhaDir);
+}
+
+// Coluna x com [x, x+largura) na água e pelo menos 'folga' colunas de
+// água sobrando no mesmo canal (para o avião passar); -1 se não cabe
+int colunaLivre(Rng *r, const LinhaRio *l, int largura, int folga)
+{
+    int canais[2][2] = {{l->esq + 1, l->dir}, {0, 0}};
+    int nCanais = 1;
+    if (l->ilhaDir > l->ilhaEsq)
+    {
+        canais[0][1] = l->ilhaEsq;
+        canais[1][0] = l->ilhaDir;
+        canais[1][1] = l->dir;
+        nCanais = 2;
+    }
+
+    int cabem[2], nCabem = 0;
+    for (int c = 0; c < nCanais; c++)
+        if (canais[c][1] - canais[c][0] >= largura + folga)
+            cabem[nCabem++] = c;
+    if (nCabem == 0)
+        return -1;
+
+    const int *canal = canais[cabem[nCabem > 1 ? rngAte(r, nCabem) : 0]];
+    return canal[0] + rngAte(r, canal[1] - canal[0] - largura + 1);
+}
+
+// Linha y da tela (0 = topo) dentro do anel de margens
+LinhaRio *linhaDoRio(const Jogo *j, int y)
+{
+    int i = j->topoRio + y;
+    if (i >= ALTURA)
+        i -= ALTURA;
+    return &j->rio[i];
+}
+
+// ================================================================
+// DESENHO
+// ----------------------------------------------------------------
+// A cena é montada em um quadro na memória (um chtype por célula).
+// enviarQuadro compara com o quadro que já está na tela e, em cada
+// linha, manda ao ncurses só o trecho entre a primeira e a última
+// célula que mudaram.
+// Como o rio desce 1 linha por passo, antes da comparação a tela é
+// rolada com scrl() (o terminal faz a rolagem); aí o terreno antigo já
+// está no lugar certo e só a linha nova do topo e os sprites que se
+// movem em relação ao rio precisam ser enviados.
+// ================================================================
+// Os quadros têm o tamanho da tela; o retrato, o do mundo
+void alocarQuadros(int largura, int altura)
+{
+    larguraTela = largura;
+    alturaTela = altura;
+    quadro = (chtype *)calloc((size_t)larguraTela * alturaTela, sizeof(chtype));
+    quadroNaTela = (chtype *)calloc((size_t)larguraTela * alturaTela, sizeof(chtype));
+    if (!quadro || !quadroNaTela || !alocarRetrato(&retratoLocal))
+    {
+        endwin();
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+}
+
+void liberarQuadros(void)
+{
+    free(quadro);
+    free(quadroNaTela);
+    quadro = quadroNaTela = NULL;
+    liberarRetrato(&retratoLocal);
+}
+
+// Coordenadas de tela; o que cai fora é cortado
+void pintar(int y, int x, chtype c)
+{
+    if (y >= 0 && y < alturaTela && x >= 0 && x < larguraTela)
+        quadro[y * larguraTela + x] = c;
+}
+
+void pintarTexto(int y, int x, const char *texto, chtype atributos)
+{
+    for (; *texto; texto++, x++)
+        pintar(y, x, (unsigned char)*texto | atributos);
+}
+
+void enviarQuadro(int rolar)
+{
+    if (rolar > 0 && rolar < alturaTela)
+    {
+        scrl(-rolar); // desce o conteúdo da tela 'rolar' linhas
+        chamadasCurses++;
+
+        // Mantém a cópia do que está na tela igual ao terminal rolado
+        memmove(quadroNaTela + (size_t)rolar * larguraTela, quadroNaTela,
+                sizeof(chtype) * (size_t)(alturaTela - rolar) * larguraTela);
+        memset(quadroNaTela, 0, sizeof(chtype) * (size_t)rolar * larguraTela);
+    }
+
+    celulasNoQuadro = 0;
+    for (int y = 0; y < alturaTela; y++)
+    {
+        const chtype *novo = quadro + y * larguraTela;
+        const chtype *velho = quadroNaTela + y * larguraTela;
+
+        int x0 = 0;
+        while (x0 < larguraTela && novo[x0] == velho[x0])
+            x0++;
+        if (x0 == larguraTela)
+            continue; // linha igual à que já está na tela
+
+        int x1 = larguraTela - 1;
+        while (novo[x1] == velho[x1])
+            x1--;
+
+        mvaddchnstr(y, x0, novo + x0, x1 - x0 + 1);
+        chamadasCurses++;
+        celulasNoQuadro += x1 - x0 + 1;
+    }
+    refresh();
+    chamadasCurses++;
+
+    // O quadro enviado vira a referência; o outro buffer será remontado
+    chtype *tmp = quadroNaTela;
+    quadroNaTela = quadro;
+    quadro = tmp;
+
+    celulasTotal += celulasNoQuadro;
+    quadrosDesenhados++;
+}
+
+void desenharAviao(const Player *p)
+{
+    for (int r = 0; r < AVIAO_H; r++)
+    {
+        int y = p->y + r - cameraY;
+        for (int c = 0; c < AVIAO_W; c++)
+        {
+            char ch = AVIAO[r][c];
+            if (ch == ' ')
+                continue;
+            int x = p->x + c - cameraX;
+            pintar(y, x, (p->vivo ? ch : 'X') | COLOR_PAIR(2));
+        }
+    }
+}
+
+// Sprites recebem coordenadas do mundo e descontam a câmera
+void desenharInimigo(int ix, int iy)
+{
+    for (int r = 0; r < INIMIGO_H; r++)
+    {
+        int y = iy + r - cameraY;
+        if (y < 0 || y >= alturaTela || iy + r >= ALTURA)
+            continue; // fora da tela ou já abaixo do fim do mundo
+
+        for (int c = 0; c < INIMIGO_W; c++)
         {
             char ch = INIMIGO[r][c];
             if (ch == ' ')
                 continue;
 
-            int x = in->x + c;
-            if (x >= 0 && x < LARGURA)
-                mvaddch(y, x, ch);
-        }
+            int x = ix + c - cameraX;
+            if (x >= 0 && x < larguraTela)
+                pintar(y, x, (unsigned char)ch | COLOR_PAIR(3));
+        }
+    }
+}
+
+// Cores: configuradas uma única vez (em iniciarNcurses)
+void iniciarCores(void)
+{
+    start_color(); // Permite o uso de cores
+
+    init_pair(1, COLOR_GREEN, COLOR_BLACK);   // cor verde
+    init_pair(2, COLOR_YELLOW, COLOR_BLACK);  // cor amarelha
+    init_pair(3, COLOR_RED, COLOR_BLACK);     // cor vermelha
+    init_pair(4, COLOR_MAGENTA, COLOR_BLACK); // cor ciano
+    init_pair(5, COLOR_BLUE, COLOR_BLACK);
+    init_pair(6, COLOR_BLACK, COLOR_YELLOW);
+}
+
+// Preenche as colunas [x0, x1) da linha y com a mesma célula
+void pintarFaixa(int y, int x0, int x1, chtype c)
+{
+    if (y < 0 || y >= alturaTela)
+        return;
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > larguraTela)
+        x1 = larguraTela;
+
+    chtype *linha = quadro + y * larguraTela;
+    for (int x = x0; x < x1; x++)
+        linha[x] = c;
+}
+
+// Desenho sem threads (benchmarks): retrata o mundo e desenha na hora
+void desenharTudo(const Jogo *j)
+{
+    capturarRetrato(&retratoLocal, j);
+    desenharRetrato(&retratoLocal);
+}
+
+// Câmera: centraliza o avião na tela sem mostrar nada fora do mundo.
+// Na vertical isso deixa a tela presa ao fundo, onde o avião voa.
+void posicionarCamera(const Player *p)
+{
+    cameraX = p->x + AVIAO_W / 2 - larguraTela / 2;
+    if (cameraX > LARGURA - larguraTela)
+        cameraX = LARGURA - larguraTela;
+    if (cameraX < 0)
+        cameraX = 0; // mundo mais estreito que a tela: encostado à esquerda
+
+    cameraY = p->y + AVIAO_H / 2 - alturaTela / 2;
+    if (cameraY > ALTURA - alturaTela)
+        cameraY = ALTURA - alturaTela;
+    if (cameraY < 0)
+        cameraY = 0;
+}
+
+// Só lê o retrato: roda na thread de desenho sem tocar no mundo
+void desenharRetrato(const Retrato *r)
+{
+    posicionarCamera(&r->jogador);
+
+    // Cada linha do rio são 3 faixas: terra | água | terra
+    for (int y = 0; y < alturaTela; y++)
+    {
+        int linhaMundo = y + cameraY;
+        if (linhaMundo >= ALTURA)
+        {
+            pintarFaixa(y, 0, larguraTela, ' '); // abaixo do mundo
+            continue;
+        }
+        const LinhaRio *linha = &r->margens[linhaMundo];
+        int fim = LARGURA - cameraX;
+        pintarFaixa(y, 0, linha->esq + 1 - cameraX, '#' | COLOR_PAIR(1));
+        pintarFaixa(y, linha->esq + 1 - cameraX, linha->dir - cameraX, ' ' | COLOR_PAIR(5));
+        pintarFaixa(y, linha->dir - cameraX, fim, '#' | COLOR_PAIR(1));
+        pintarFaixa(y, linha->ilhaEsq - cameraX, linha->ilhaDir - cameraX, '#' | COLOR_PAIR(1));
+        pintarFaixa(y, fim, larguraTela, ' ');
+    }
+
+    // Desenha o inimigo
+    for (int i = 0; i < r->nInimigos; i++)
+        desenharInimigo(r->inimigoX[i], r->inimigoY[i]);
+
+    for (int i = 0; i < r->nPostos; i++)
+        pintarTexto(r->postoY[i] - cameraY, r->postoX[i] - cameraX, "[FUEL]", COLOR_PAIR(4));
+
+    desenharBalas(r->balaX, r->balaY, r->nBalas); // desenha todas as balas na tela
+
+    const Player *p = &r->jogador;
+    desenharAviao(p);
+
+    char morte[64] = "";
+    if (!p->vivo && r->posicaoPlacar > 0)
+        snprintf(morte, sizeof morte, "[MORREU #%ld de %ld - R=recomecar]", r->posicaoPlacar, r->totalPlacar);
+    else if (!p->vivo)
+        snprintf(morte, sizeof morte, "[MORREU - R=recomecar]");
+
+    char hud[128];
+    snprintf(hud, sizeof hud, "SCORE: %ld  FUEL: %d  %s  | %s  V=voltar  Q=sair",
+             p->score, p->fuel, morte,
+             pilotoLigado ? "PILOTO AUTOMATICO" : "ESPACO=tiro");
+    pintarTexto(0, 2, hud, COLOR_PAIR(6));
+    if (perfilLigado)
+    {
+        pintarTexto(1, 2, r->perfil[0], COLOR_PAIR(6));
+        pintarTexto(2, 2, r->perfil[1], COLOR_PAIR(6));
+    }
+
+    // O rio desceu; se a câmera desceu junto, a tela rola menos
+    int rolar = (int)(r->linhasRoladas - linhasNaTela) - (cameraY - cameraYNaTela);
+    linhasNaTela = r->linhasRoladas;
+    cameraYNaTela = cameraY;
+    enviarQuadro(rolar);
+}
+
+// ================================================================
+// COLISÃO E RESET
+// ================================================================
+// Máscaras de colisão: cada linha do sprite vira um inteiro com 1 bit
+// por coluna (bit c = coluna c). Compiladas uma vez em compilarMascaras.
+Mascara compilarMascara(const char **sprite, int h, int w, int caixaCheia)
+{
+    Mascara m = {h, w, {0}};
+    for (int r = 0; r < h; r++)
+    {
+        for (int c = 0; c < w; c++)
+        {
+            if (caixaCheia || sprite[r][c] != ' ')
+                m.linhas[r] |= 1u << c;
+        }
+    }
+    return m;
+}
+
+void compilarMascaras(void)
+{
+    mascaraAviao = compilarMascara(AVIAO, AVIAO_H, AVIAO_W, 0);
+    // Inimigo colide pelo retângulo inteiro (regra do README)
+    mascaraInimigo = compilarMascara(INIMIGO, INIMIGO_H, INIMIGO_W, 1);
+}
+
+// Bits [lo, hi] ligados (limitados a 0..31); vazio se lo > hi
+uint32_t faixaDeBits(int lo, int hi)
+{
+    if (lo < 0)
+        lo = 0;
+    if (hi > 31)
+        hi = 31;
+    if (lo > hi)
+        return 0;
+    uint32_t ateHi = (hi == 31) ? 0xFFFFFFFFu : (1u << (hi + 1)) - 1;
+    return ateHi & ~((1u << lo) - 1);
+}
+
+// 0 se o avião está livre; senão a causa da morte (CAUSA_MARGEM ou
+// CAUSA_INIMIGO)
+int haColisao(const Jogo *j)
+{
+    const Player *p = &j->jogador;
+    // 1) Avião x margens: água da linha vista a partir da coluna p->x
+    for (int r = 0; r < AVIAO_H; r++)
+    {
+        int y = p->y + r;
+        if (y < 0 || y >= ALTURA)
+            continue;
+        const LinhaRio *linha = linhaDoRio(j, y);
+        uint32_t agua = faixaDeBits(linha->esq + 1 - p->x, linha->dir - 1 - p->x) &
+                        ~faixaDeBits(linha->ilhaEsq - p->x, linha->ilhaDir - 1 - p->x);
+        if (mascaraAviao.linhas[r] & ~agua)
+            return CAUSA_MARGEM;
+    }
+
+    // 2) Avião x inimigos: descarta pela caixa, depois AND das máscaras
+    for (int w = 0; w < j->inimigos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->inimigos.vivo[w]; bits; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            int dx = j->inimigos.x[i] - p->x;
+            int dy = j->inimigos.y[i] - p->y;
+            if (dx >= AVIAO_W || dx <= -INIMIGO_W || dy >= AVIAO_H || dy <= -INIMIGO_H)
+                continue;
+
+            for (int r = 0; r < AVIAO_H; r++)
+            {
+                int ri = r - dy; // linha correspondente no inimigo
+                if (ri < 0 || ri >= INIMIGO_H || p->y + r >= ALTURA)
+                    continue;
+                uint32_t m = mascaraInimigo.linhas[ri];
+                m = (dx >= 0) ? m << dx : m >> -dx;
+                if (mascaraAviao.linhas[r] & m)
+                    return CAUSA_INIMIGO;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void reiniciarJogo(Jogo *j)
+{
+    Player *p = &j->jogador;
+    j->tick_usec = TICK_START_USEC;
+    iniciarBalas(j);
+    p->y = ALTURA - 4;
+    if (j->filaRioN > 0)
+    {
+        recomecarRio(j); // recomeço: o rio segue de onde estava
+        p->x = colunaDeRecomeco(j, p->y + 1);
+    }
+    else
+    {
+        criarRioInicial(j);
+        p->x = LARGURA / 2;
+    }
+    p->vivo = 1;
+    p->score = 0;
+    p->fuel = 100; // NOVO: tanque cheio
+    ReiniciarInimigos(j);
+    ReiniciarGasolina(j);
+    j->inicioVida = j->contadorLinha;
+    emitirEvento(j, EVENTO_RECOMECO, 0, p->x, p->y, 0);
+}
+
+// Partida do zero: sementes, contadores e rio novos
+void novaPartida(Jogo *j, uint64_t s)
+{
+    semearAleatorios(j, s);
+    j->contadorLinha = 0;
+    j->contadorSpawn = 0;
+    j->limiteSpawn = 20; // menor valor = inimigos nascem com mais frequência
+    j->fuelTick = 0;
+    j->filaRioN = 0; // sem fila: reiniciarJogo cria o rio do zero
+    reiniciarJogo(j);
+}
+
+void ReiniciarInimigos(Jogo *j)
+{
+    reiniciarEntidades(&j->inimigos);
+}
+
+void ReiniciarGasolina(Jogo *j)
+{
+    reiniciarEntidades(&j->postos);
+}
+
+// Todas as vagas livres; o topo da pilha é o índice 0
+void reiniciarVagas(ListaVagas *v, int capacidade)
+{
+    v->nLivres = capacidade;
+    for (int k = 0; k < capacidade; k++)
+        v->livres[k] = capacidade - 1 - k;
+}
+
+int pegarVaga(ListaVagas *v)
+{
+    if (v->nLivres == 0)
+    {
+        v->rejeitados++;
+        return -1;
+    }
+    return v->livres[--v->nLivres];
+}
+
+void devolverVaga(ListaVagas *v, int i)
+{
+    v->livres[v->nLivres++] = i;
+}
+
+// ================================================================
+// ENTIDADES (inimigos e gasolina em estrutura de vetores)
+// ================================================================
+int alocarEntidades(Entidades *e, int capacidade)
+{
+    e->cap = capacidade;
+    e->nPalavras = (capacidade + 63) / 64;
+    size_t vagas = (size_t)e->nPalavras * 64; // folga até múltiplo de 64
+    e->x = (int16_t *)calloc(vagas, sizeof(int16_t));
+    e->y = (int16_t *)calloc(vagas, sizeof(int16_t));
+    e->vivo = (uint64_t *)calloc(e->nPalavras, sizeof(uint64_t));
+    e->vagas.livres = (int *)malloc(sizeof(int) * capacidade);
+    e->vagas.nLivres = 0;
+    e->vagas.rejeitados = 0;
+    return e->x && e->y && e->vivo && e->vagas.livres;
+}
+
+void liberarEntidades(Entidades *e)
+{
+    free(e->x);
+    free(e->y);
+    free(e->vivo);
+    free(e->vagas.livres);
+}
+
+void reiniciarEntidades(Entidades *e)
+{
+    memset(e->vivo, 0, sizeof(uint64_t) * e->nPalavras);
+    reiniciarVagas(&e->vagas, e->cap);
+}
+
+int estaVivo(const Entidades *e, int i)
+{
+    return (e->vivo[i >> 6] >> (i & 63)) & 1;
+}
+
+// Ocupa a vaga i (já tirada de e->vagas) na posição (x, y)
+void nascer(Entidades *e, int i, int x, int y)
+{
+    e->x[i] = (int16_t)x;
+    e->y[i] = (int16_t)y;
+    e->vivo[i >> 6] |= 1ull << (i & 63);
+}
+
+void matar(Entidades *e, int i)
+{
+    e->vivo[i >> 6] &= ~(1ull << (i & 63));
+    devolverVaga(&e->vagas, i);
+}
+
+// Bits das 64 vagas a partir de y[] cuja linha já passou de ALTURA - 1
+uint64_t abaixoDaTela(const int16_t *y)
+{
+    uint64_t bits = 0;
+#ifdef __SSE2__
+    __m128i limite = _mm_set1_epi16((int16_t)(ALTURA - 1));
+    for (int k = 0; k < 64; k += 16)
+    {
+        __m128i a = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i *)(y + k)), limite);
+        __m128i b = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i *)(y + k + 8)), limite);
+        // 16 comparações viram 16 bytes 0x00/0xFF e depois 16 bits
+        uint64_t m = (uint16_t)_mm_movemask_epi8(_mm_packs_epi16(a, b));
+        bits |= m << k;
+    }
+#else
+    for (int k = 0; k < 64; k++)
+        bits |= (uint64_t)(y[k] >= ALTURA) << k;
+#endif
+    return bits;
+}
+
+// Desce todas as entidades 1 linha e apaga as que saíram da tela.
+// A descida não testa 'vivo': somar 1 em vagas livres é inofensivo e
+// deixa o laço sem desvios (vetorizado). O teto em INT16_MAX evita
+// estouro em vagas paradas há muito tempo.
+void moverEntidades(Entidades *e)
+{
+    int16_t *y = e->y;
+    int n = e->nPalavras * 64;
+
+#ifdef __SSE2__
+    __m128i um = _mm_set1_epi16(1);
+    for (int i = 0; i < n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(y + i));
+        _mm_storeu_si128((__m128i *)(y + i), _mm_adds_epi16(v, um));
+    }
+#else
+    for (int i = 0; i < n; i++)
+        y[i] = (int16_t)(y[i] + (y[i] < INT16_MAX));
+#endif
+
+    for (int w = 0; w < e->nPalavras; w++)
+    {
+        uint64_t saiu = abaixoDaTela(y + w * 64) & e->vivo[w];
+        e->vivo[w] &= ~saiu;
+        for (; saiu; saiu &= saiu - 1)
+            devolverVaga(&e->vagas, w * 64 + __builtin_ctzll(saiu));
+    }
+}
+
+// ================================================================
+// PIPELINE: SIMULAÇÃO E DESENHO EM THREADS
+// ----------------------------------------------------------------
+// A thread principal simula e publica retratos; a de desenho pega só o
+// mais novo (os atrasados são pulados) e também lê o teclado, já que o
+// ncurses não pode ser usado por duas threads.
+// ================================================================
+int alocarRetrato(Retrato *r)
+{
+    r->margens = (LinhaRio *)malloc(sizeof(LinhaRio) * ALTURA);
+    r->inimigoX = (int16_t *)malloc(sizeof(int16_t) * capInimigos);
+    r->inimigoY = (int16_t *)malloc(sizeof(int16_t) * capInimigos);
+    r->postoX = (int16_t *)malloc(sizeof(int16_t) * capPostos);
+    r->postoY = (int16_t *)malloc(sizeof(int16_t) * capPostos);
+    r->nInimigos = r->nPostos = r->nBalas = 0;
+    return r->margens && r->inimigoX && r->inimigoY && r->postoX && r->postoY;
+}
+
+void liberarRetrato(Retrato *r)
+{
+    free(r->margens);
+    free(r->inimigoX);
+    free(r->inimigoY);
+    free(r->postoX);
+    free(r->postoY);
+    r->margens = NULL;
+    r->inimigoX = r->inimigoY = r->postoX = r->postoY = NULL;
+}
+
+// Copia o estado visível do mundo (só os vivos, já compactados)
+void capturarRetrato(Retrato *r, const Jogo *j)
+{
+    for (int y = 0; y < ALTURA; y++)
+        r->margens[y] = *linhaDoRio(j, y);
+
+    r->nInimigos = 0;
+    for (int w = 0; w < j->inimigos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->inimigos.vivo[w]; bits; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            r->inimigoX[r->nInimigos] = j->inimigos.x[i];
+            r->inimigoY[r->nInimigos] = j->inimigos.y[i];
+            r->nInimigos++;
+        }
+    }
+
+    r->nPostos = 0;
+    for (int w = 0; w < j->postos.nPalavras; w++)
+    {
+        for (uint64_t bits = j->postos.vivo[w]; bits; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            r->postoX[r->nPostos] = j->postos.x[i];
+            r->postoY[r->nPostos] = j->postos.y[i];
+            r->nPostos++;
+        }
+    }
+
+    r->nBalas = j->nBalas;
+    memcpy(r->balaX, j->balaX, sizeof(int) * j->nBalas);
+    memcpy(r->balaY, j->balaY, sizeof(int) * j->nBalas);
+
+    r->jogador = j->jogador;
+    r->linhasRoladas = j->linhasRoladas;
+    // Posição só quando a thread do placar já gravou a morte mais recente
+    r->posicaoPlacar = r->totalPlacar = 0;
+    if (placarLigado && !j->jogador.vivo)
+    {
+        long feitos = atomic_load(&placar.processados);
+        if (feitos > 0 && feitos == atomic_load(&placar.enviados))
+        {
+            r->posicaoPlacar = atomic_load(&placar.ultimaPosicao);
+            r->totalPlacar = atomic_load(&placar.total);
+        }
+    }
+    if (perfilLigado)
+        textoPerfil(r->perfil);
+}
+
+// Simulação: preenche o retrato de escrita e troca com o do meio
+void publicarRetrato(const Jogo *j)
+{
+    capturarRetrato(&retratos[retratoEscrita], j);
+    int antigo = atomic_exchange(&retratoMeio, retratoEscrita | RETRATO_NOVO);
+    retratoEscrita = antigo & 3;
+    retratosPublicados++;
+    tocar(campainhaDesenho[1]);
+}
+
+// Desenho: o retrato mais novo, ou NULL se nada mudou desde o último
+const Retrato *pegarRetratoNovo(void)
+{
+    if (!(atomic_load(&retratoMeio) & RETRATO_NOVO))
+        return NULL;
+    int antigo = atomic_exchange(&retratoMeio, retratoLeitura);
+    retratoLeitura = antigo & 3;
+    return &retratos[retratoLeitura];
+}
+
+// Fila de teclas: só a thread de desenho põe, só a simulação tira
+int porTecla(int ch, long long chegada)
+{
+    unsigned cauda = atomic_load_explicit(&filaCauda, memory_order_relaxed);
+    if (cauda - atomic_load_explicit(&filaCabeca, memory_order_acquire) == FILA_TECLAS)
+        return 0;
+    filaTeclas[cauda % FILA_TECLAS] = (TeclaLida){ch, chegada};
+    atomic_store_explicit(&filaCauda, cauda + 1, memory_order_release);
+    return 1;
+}
+
+int tirarTecla(int *ch, long long *chegada)
+{
+    unsigned cabeca = atomic_load_explicit(&filaCabeca, memory_order_relaxed);
+    if (cabeca == atomic_load_explicit(&filaCauda, memory_order_acquire))
+        return 0;
+    *ch = filaTeclas[cabeca % FILA_TECLAS].ch;
+    *chegada = filaTeclas[cabeca % FILA_TECLAS].chegada;
+    atomic_store_explicit(&filaCabeca, cabeca + 1, memory_order_release);
+    return 1;
+}
+
+// Acorda quem espera no pipe; com o pipe cheio o aviso já está dado
+void tocar(int fd)
+{
+    char c = 1;
+    if (write(fd, &c, 1) < 0)
+        return;
+}
+
+void esvaziarAviso(int fd)
+{
+    char lixo[64];
+    while (read(fd, lixo, sizeof lixo) > 0)
+        ;
+}
+
+void *lacoDesenho(void *arg)
+{
+    (void)arg;
+    struct pollfd fds[2] = {{campainhaDesenho[0], POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+
+    while (!atomic_load(&fimDesenho))
+    {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+
+        if (fds[1].revents & POLLIN)
+        {
+            int ch, chegou = 0;
+            long long agora = agoraNs();
+            while ((ch = getch()) != ERR)
+            {
+                if (porTecla(ch, agora))
+                    chegou = 1;
+                else
+                    teclasPerdidas++;
+            }
+            if (chegou)
+                tocar(avisoTeclas[1]);
+        }
+        if (fds[0].revents & POLLIN)
+            esvaziarAviso(campainhaDesenho[0]);
+
+        const Retrato *r = pegarRetratoNovo();
+        if (r)
+        {
+            long long t0 = agoraNs();
+            desenharRetrato(r);
+            long long gasto = agoraNs() - t0;
+            somaDesenhoNs += gasto;
+            atomic_store(&ultimoDesenhoNs, gasto);
+            retratosDesenhados++;
+        }
+    }
+    return NULL;
+}
+
+int abrirPipeSemEspera(int fds[2])
+{
+    if (pipe(fds) < 0)
+        return 0;
+    for (int i = 0; i < 2; i++)
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    return 1;
+}
+
+// Depois de iniciarNcurses: daqui em diante só a thread de desenho usa o ncurses
+void iniciarPipeline(void)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (!alocarRetrato(&retratos[i]))
+        {
+            endwin();
+            fprintf(stderr, "Falha ao alocar memória.\n");
+            exit(1);
+        }
+    }
+    if (!abrirPipeSemEspera(campainhaDesenho) || !abrirPipeSemEspera(avisoTeclas) ||
+        pthread_create(&threadDesenho, NULL, lacoDesenho, NULL) != 0)
+    {
+        endwin();
+        perror("pipeline");
+        exit(1);
+    }
+}
+
+void finalizarPipeline(void)
+{
+    atomic_store(&fimDesenho, 1);
+    tocar(campainhaDesenho[1]);
+    pthread_join(threadDesenho, NULL);
+
+    for (int i = 0; i < 2; i++)
+    {
+        close(campainhaDesenho[i]);
+        close(avisoTeclas[i]);
+    }
+    for (int i = 0; i < 3; i++)
+        liberarRetrato(&retratos[i]);
+}
+
+// ================================================================
+// PERFIL POR FASE
+// ================================================================
+// Cada marcarFase soma ao quadro atual o tempo desde a marca anterior,
+// então as fases cobrem o quadro inteiro sem buracos. Desligado, custa
+// só um teste.
+void iniciarPerfil(void)
+{
+    if (!perfilLigado)
+        return;
+    if (caminhoPerfilCsv)
+    {
+        arquivoPerfilCsv = fopen(caminhoPerfilCsv, "w");
+        if (!arquivoPerfilCsv)
+        {
+            if (!modoHeadless)
+                endwin();
+            perror(caminhoPerfilCsv);
+            exit(1);
+        }
+        fprintf(arquivoPerfilCsv, "quadro");
+        for (int f = 0; f < NFASES; f++)
+            fprintf(arquivoPerfilCsv, ",%s_ns", nomesFases[f]);
+        fprintf(arquivoPerfilCsv, ",total_ns\n");
+    }
+    memset(tempoFase, 0, sizeof tempoFase);
+    marcaPerfil = agoraNs();
+}
+
+void marcarFase(int fase)
+{
+    if (!perfilLigado || perfilPausado)
+        return;
+    long long agora = agoraNs();
+    tempoFase[fase] += agora - marcaPerfil;
+    marcaPerfil = agora;
+}
+
+// Fecha o quadro: entra na janela do HUD e vira uma linha do CSV
+void fecharQuadroPerfil(void)
+{
+    long long total = 0;
+    for (int f = 0; f < NFASES; f++)
+    {
+        janelaPerfil[f][posJanelaPerfil] = tempoFase[f];
+        total += tempoFase[f];
+    }
+    posJanelaPerfil = (posJanelaPerfil + 1) % JANELA_PERFIL;
+    if (nJanelaPerfil < JANELA_PERFIL)
+        nJanelaPerfil++;
+
+    if (arquivoPerfilCsv)
+    {
+        fprintf(arquivoPerfilCsv, "%ld", quadrosPerfil);
+        for (int f = 0; f < NFASES; f++)
+            fprintf(arquivoPerfilCsv, ",%lld", tempoFase[f]);
+        fprintf(arquivoPerfilCsv, ",%lld\n", total);
+    }
+    quadrosPerfil++;
+    memset(tempoFase, 0, sizeof tempoFase);
+}
+
+int compararLongLong(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int compararLong(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Média, p99 e máximo (em ns) da fase nos últimos JANELA_PERFIL quadros
+void estatisticaFase(int fase, double *media, double *p99, double *maximo)
+{
+    long long ordenado[JANELA_PERFIL];
+    long long soma = 0;
+    *media = *p99 = *maximo = 0;
+    if (nJanelaPerfil == 0)
+        return;
+
+    memcpy(ordenado, janelaPerfil[fase], nJanelaPerfil * sizeof ordenado[0]);
+    qsort(ordenado, nJanelaPerfil, sizeof ordenado[0], compararLongLong);
+    for (int i = 0; i < nJanelaPerfil; i++)
+        soma += ordenado[i];
+
+    *media = (double)soma / nJanelaPerfil;
+    *p99 = (double)ordenado[(nJanelaPerfil * 99) / 100];
+    *maximo = (double)ordenado[nJanelaPerfil - 1];
+}
+
+// Duas linhas para baixo do SCORE/FUEL: média/p99/máx em µs por fase.
+// Montadas na simulação e levadas pelo retrato até o desenho.
+void textoPerfil(char linhas[2][160])
+{
+    static char cache[2][160];
+    static long ultimaConta = -1;
+
+    // Ordenar a janela a cada quadro seria ruído no próprio perfil
+    if (ultimaConta < 0 || quadrosPerfil - ultimaConta >= 16)
+    {
+        ultimaConta = quadrosPerfil;
+        for (int l = 0; l < 2; l++)
+        {
+            int usado = snprintf(cache[l], sizeof cache[l], l == 0 ? "us med/p99/max:" : "               ");
+            for (int f = l * NFASES / 2; f < (l == 0 ? NFASES / 2 : NFASES); f++)
+            {
+                double media, p99, maximo;
+                estatisticaFase(f, &media, &p99, &maximo);
+                usado += snprintf(cache[l] + usado, sizeof cache[l] - usado, " %s %.0f/%.0f/%.0f",
+                                  nomesFases[f], media / 1000, p99 / 1000, maximo / 1000);
+            }
+        }
+        snprintf(cache[1] + strlen(cache[1]), sizeof cache[1] - strlen(cache[1]),
+                 " | desenho %.0f", atomic_load(&ultimoDesenhoNs) / 1000.0);
+    }
+    memcpy(linhas, cache, sizeof cache);
+}
+
+// Resumo ao sair (depois do endwin) e fechamento do CSV
+void finalizarPerfil(void)
+{
+    if (!perfilLigado)
+        return;
+    if (arquivoPerfilCsv)
+    {
+        fclose(arquivoPerfilCsv);
+        arquivoPerfilCsv = NULL;
+    }
+
+    printf("perfil dos ultimos %d quadros (us): fase media p99 max\n", nJanelaPerfil);
+    for (int f = 0; f < NFASES; f++)
+    {
+        double media, p99, maximo;
+        estatisticaFase(f, &media, &p99, &maximo);
+        printf("  %-10s %9.1f %9.1f %9.1f\n", nomesFases[f], media / 1000, p99 / 1000, maximo / 1000);
+    }
+}
+
+// ================================================================
+// GRAVAÇÃO E REPLAY
+// ================================================================
+// Arquivo: cabeçalho fixo em little-endian e depois pares
+// (byte de ações, repetições em LEB128). Junto com a semente, isso
+// basta para refazer a partida passo a passo.
+#define GRAVACAO_MAGICA "RRIN"
+#define GRAVACAO_VERSAO 3 // 3: ação ACAO_VOLTAR (a 2 é lida igual)
+#define GRAVACAO_VERSAO_MIN 2 // 2: terreno por seções (gravações da 1 refazem outro rio)
+
+void escreverU32(FILE *f, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        fputc((int)((v >> (8 * i)) & 0xFF), f);
+}
+
+void escreverU64(FILE *f, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        fputc((int)((v >> (8 * i)) & 0xFF), f);
+}
+
+int lerU32(FILE *f, uint32_t *v)
+{
+    uint8_t b[4];
+    if (fread(b, 1, 4, f) != 4)
+        return 0;
+    *v = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    return 1;
+}
+
+int lerU64(FILE *f, uint64_t *v)
+{
+    uint32_t baixo, alto;
+    if (!lerU32(f, &baixo) || !lerU32(f, &alto))
+        return 0;
+    *v = (uint64_t)alto << 32 | baixo;
+    return 1;
+}
+
+void escreverSequencia(void)
+{
+    if (repeticoesGravadas == 0)
+        return;
+    fputc((int)acaoGravada, arquivoGravacao);
+    uint64_t n = (uint64_t)repeticoesGravadas;
+    do
+    {
+        uint8_t byte = n & 0x7F;
+        n >>= 7;
+        fputc(n ? byte | 0x80 : byte, arquivoGravacao);
+    } while (n);
+}
+
+void iniciarGravacao(void)
+{
+    if (!caminhoGravacao)
+        return;
+    arquivoGravacao = fopen(caminhoGravacao, "wb");
+    if (!arquivoGravacao)
+    {
+        if (!modoHeadless)
+            endwin();
+        perror(caminhoGravacao);
+        exit(1);
+    }
+    fwrite(GRAVACAO_MAGICA, 1, 4, arquivoGravacao);
+    escreverU32(arquivoGravacao, GRAVACAO_VERSAO);
+    escreverU64(arquivoGravacao, semente);
+    escreverU32(arquivoGravacao, (uint32_t)LARGURA);
+    escreverU32(arquivoGravacao, (uint32_t)ALTURA);
+    escreverU32(arquivoGravacao, (uint32_t)capInimigos);
+    escreverU32(arquivoGravacao, (uint32_t)capPostos);
+    escreverU32(arquivoGravacao, (uint32_t)cadenciaTiro);
+    repeticoesGravadas = 0;
+}
+
+void gravarPasso(unsigned acoes)
+{
+    if (repeticoesGravadas > 0 && acoes == acaoGravada)
+    {
+        repeticoesGravadas++;
+        return;
+    }
+    escreverSequencia();
+    acaoGravada = acoes;
+    repeticoesGravadas = 1;
+}
+
+void finalizarGravacao(void)
+{
+    if (!arquivoGravacao)
+        return;
+    escreverSequencia();
+    fclose(arquivoGravacao);
+    arquivoGravacao = NULL;
+}
+
+// Lê o cabeçalho e ajusta semente, campo e capacidades como na gravação
+void abrirReplay(const char *caminho)
+{
+    arquivoReplay = fopen(caminho, "rb");
+    if (!arquivoReplay)
+    {
+        perror(caminho);
+        exit(1);
+    }
+
+    char magica[4];
+    uint32_t versao, largura, altura, inimigosGravados, postosGravados, cadencia;
+    if (fread(magica, 1, 4, arquivoReplay) != 4 || memcmp(magica, GRAVACAO_MAGICA, 4) != 0 ||
+        !lerU32(arquivoReplay, &versao) || !lerU64(arquivoReplay, &semente) ||
+        !lerU32(arquivoReplay, &largura) || !lerU32(arquivoReplay, &altura) ||
+        !lerU32(arquivoReplay, &inimigosGravados) || !lerU32(arquivoReplay, &postosGravados) ||
+        !lerU32(arquivoReplay, &cadencia))
+    {
+        fprintf(stderr, "%s: não é uma gravação do River Raid.\n", caminho);
+        exit(1);
+    }
+    if (versao < GRAVACAO_VERSAO_MIN || versao > GRAVACAO_VERSAO)
+    {
+        fprintf(stderr, "%s: versão %u da gravação não suportada.\n", caminho, versao);
+        exit(1);
+    }
+    // Os mesmos limites da linha de comando (lerArgumentos)
+    if (largura < 40 || altura < 20 || largura > INT16_MAX || altura > INT16_MAX)
+    {
+        fprintf(stderr, "%s: mundo %ux%u fora de 40x20 a %dx%d.\n",
+                caminho, largura, altura, INT16_MAX, INT16_MAX);
+        exit(1);
+    }
+    if (inimigosGravados < 1 || postosGravados < 1 ||
+        inimigosGravados > INT_MAX || postosGravados > INT_MAX)
+    {
+        fprintf(stderr, "%s: capacidades inválidas (inimigos %u, postos %u).\n",
+                caminho, inimigosGravados, postosGravados);
+        exit(1);
+    }
+    if (cadencia > INT_MAX)
+    {
+        fprintf(stderr, "%s: cadência %u inválida.\n", caminho, cadencia);
+        exit(1);
+    }
+
+    sementeDada = 1;
+    LARGURA = (int)largura;
+    ALTURA = (int)altura;
+    mundoDado = 1; // o replay usa o mundo gravado, em qualquer tela
+    capInimigos = (int)inimigosGravados;
+    capPostos = (int)postosGravados;
+    cadenciaTiro = (int)cadencia;
+    repeticoesReplay = 0;
+}
+
+// Ações do próximo passo; 0 quando a gravação acabou
+int lerPassoReplay(unsigned *acoes)
+{
+    if (repeticoesReplay == 0)
+    {
+        int byte = fgetc(arquivoReplay);
+        if (byte == EOF)
+            return 0;
+        acaoReplay = (unsigned)byte;
+
+        uint64_t n = 0;
+        int desloc = 0;
+        do
+        {
+            byte = fgetc(arquivoReplay);
+            if (byte == EOF || desloc > 56)
+                return 0;
+            n |= (uint64_t)(byte & 0x7F) << desloc;
+            desloc += 7;
+        } while (byte & 0x80);
+        if (n == 0)
+            return 0;
+        repeticoesReplay = (long)n;
+    }
+
+    repeticoesReplay--;
+    *acoes = acaoReplay;
+    return 1;
+}
+
+// ================================================================
+// PILOTO AUTOMÁTICO
+// ----------------------------------------------------------------
+// Busca por ensaios: para cada ação (tiro, nada, esquerda, direita), a
+// partida é copiada (copiarJogo) e jogada PILOTO_HORIZONTE passos à
+// frente com a simulação de verdade; a morte vem de haColisao e do
+// combustível, como no jogo. Cada passo de ensaio é um "nó": nós/s mede
+// o passo da simulação mais a cópia, sem terminal no caminho.
+// ================================================================
+const unsigned acoesPiloto[] = {ACAO_TIRO, 0, ACAO_ESQ, ACAO_DIR};
+#define NACOES_PILOTO (int)(sizeof acoesPiloto / sizeof acoesPiloto[0])
+
+int iniciarPiloto(Piloto *pl)
+{
+    pl->decisoes = 0;
+    pl->nos = 0;
+    pl->tempoNs = 0;
+    semearPiloto(pl, semente);
+    return alocarJogo(&pl->ensaio);
+}
+
+void semearPiloto(Piloto *pl, uint64_t s)
+{
+    rngSemear(&pl->rng, s, 5);
+}
+
+void liberarPiloto(Piloto *pl)
+{
+    liberarJogo(&pl->ensaio);
+}
+
+// Um ramo: 'acao' por PILOTO_SEGURA passos e depois ações sorteadas.
+// Vale mais quem sobrevive mais; depois combustível e pontos (abates).
+long valorDoEnsaio(Piloto *pl, const Jogo *j, unsigned acao)
+{
+    Jogo *c = &pl->ensaio;
+    copiarJogo(c, j);
+
+    int vivos = 0;
+    while (vivos < PILOTO_HORIZONTE)
+    {
+        unsigned a = vivos < PILOTO_SEGURA ? acao : acoesPiloto[rngAte(&pl->rng, NACOES_PILOTO)];
+        atualizarJogo(c, a);
+        pl->nos++;
+        if (!c->jogador.vivo)
+            break;
+        vivos++;
+    }
+    return 1000L * vivos + 10L * c->jogador.fuel + (c->jogador.score - j->jogador.score);
+}
+
+// Ação do próximo passo (morto: reinicia)
+unsigned decidirPiloto(Piloto *pl, const Jogo *j)
+{
+    if (!j->jogador.vivo)
+        return ACAO_REINICIAR;
+
+    long long t0 = agoraNs();
+    if (perfilLigado)
+        perfilPausado = 1; // o tempo todo vai para FASE_PILOTO
+    unsigned melhor = 0;
+    long melhorValor = LONG_MIN;
+    for (int a = 0; a < NACOES_PILOTO; a++)
+    {
+        for (int e = 0; e < PILOTO_ENSAIOS; e++)
+        {
+            long v = valorDoEnsaio(pl, j, acoesPiloto[a]);
+            if (v > melhorValor)
+            {
+                melhorValor = v;
+                melhor = acoesPiloto[a];
+            }
+        }
+    }
+    if (perfilLigado)
+        perfilPausado = 0;
+    pl->decisoes++;
+    pl->tempoNs += agoraNs() - t0;
+    return melhor;
+}
+
+void resumoPiloto(const Piloto *pl)
+{
+    if (pl->decisoes == 0)
+        return;
+    printf("piloto: %ld decisoes, %lld nos (%.0f nos/s, %.1f us/decisao)\n",
+           pl->decisoes, pl->nos, pl->tempoNs > 0 ? pl->nos * 1e9 / pl->tempoNs : 0.0,
+           pl->tempoNs / 1e3 / pl->decisoes);
+}
+
+// ================================================================
+// INSTANTÂNEOS E REBOBINAR
+// ----------------------------------------------------------------
+// Tudo o que reiniciarJogo prepara (jogador, entidades, balas, margens,
+// fila do terreno, contadores e estado dos geradores) está no Jogo e na
+// sua arena, então o instantâneo é só a cópia desses dois pedaços.
+// ================================================================
+size_t tamanhoInstantaneo(const Jogo *j)
+{
+    return (offsetof(Instantaneo, arena) + j->tamArena + 63) & ~(size_t)63;
+}
+
+void salvarInstantaneo(Instantaneo *s, const Jogo *j)
+{
+    s->magica = INSTANTANEO_MAGICA;
+    s->versao = INSTANTANEO_VERSAO;
+    s->tamanho = tamanhoInstantaneo(j);
+    memcpy(&s->jogo, j, sizeof *j);
+    memcpy(s->arena, j->arena, j->tamArena);
+}
+
+// 0 se o bloco não é um instantâneo desta versão para um Jogo deste tamanho
+int restaurarInstantaneo(Jogo *j, const Instantaneo *s)
+{
+    if (s->magica != INSTANTANEO_MAGICA || s->versao != INSTANTANEO_VERSAO ||
+        s->tamanho != tamanhoInstantaneo(j))
+        return 0;
+    char *arena = j->arena;
+    Telemetria *eventos = j->eventos;
+    memcpy(j, &s->jogo, sizeof *j);
+    memcpy(arena, s->arena, j->tamArena);
+    apontarArena(j, arena);
+    j->eventos = eventos;
+    return 1;
+}
+
+// 0 se faltou memória
+int iniciarAnel(const Jogo *j)
+{
+    anel.tamanho = tamanhoInstantaneo(j);
+    anel.cap = (int)(REBOBINAR_SEGUNDOS * 1000000L / TICK_MIN_USEC) + 1;
+    anel.memoria = (char *)aligned_alloc(64, anel.tamanho * anel.cap);
+    if (!anel.memoria)
+    {
+        anel.cap = 0;
+        return 0;
+    }
+    anel.inicio = anel.n = 0;
+    return 1;
+}
+
+// Esquece os instantâneos (a memória continua alocada)
+void esvaziarAnel(void)
+{
+    anel.inicio = anel.n = 0;
+}
+
+void liberarAnel(void)
+{
+    free(anel.memoria);
+    anel.memoria = NULL;
+    anel.cap = 0;
+}
+
+// k-ésimo instantâneo do anel, do mais antigo (0) para o mais novo
+Instantaneo *instantaneoDoAnel(int k)
+{
+    return (Instantaneo *)(anel.memoria + (size_t)((anel.inicio + k) % anel.cap) * anel.tamanho);
+}
+
+// Guarda a partida antes do passo; cheio, sobrescreve o mais antigo
+void guardarNoAnel(const Jogo *j)
+{
+    long long t0 = agoraNs();
+    if (anel.n == anel.cap)
+    {
+        anel.inicio = (anel.inicio + 1) % anel.cap;
+        anel.n--;
+    }
+    salvarInstantaneo(instantaneoDoAnel(anel.n), j);
+    anel.n++;
+    anel.salvos++;
+    anel.somaNs += agoraNs() - t0;
+}
+
+// Volta REBOBINAR_SEGUNDOS no ritmo atual (ou até o mais antigo). Os
+// instantâneos mais novos que o restaurado são descartados.
+void rebobinar(Jogo *j)
+{
+    if (anel.n == 0)
+        return;
+    long passos = REBOBINAR_SEGUNDOS * 1000000L / j->tick_usec;
+    if (passos > anel.n)
+        passos = anel.n;
+    anel.n -= (int)passos;
+    if (restaurarInstantaneo(j, instantaneoDoAnel(anel.n)))
+    {
+        anel.rebobinadas++;
+        emitirEvento(j, EVENTO_VOLTA, 0, j->jogador.x, j->jogador.y, passos);
+    }
+}
+
+void resumoAnel(void)
+{
+    if (anel.salvos == 0)
+        return;
+    printf("instantaneos: %ld salvos de %zu bytes, %.0f ns/passo em media; anel de %d (%.1f MB), %ld rebobinadas\n",
+           anel.salvos, anel.tamanho, (double)anel.somaNs / anel.salvos, anel.cap,
+           anel.tamanho * (double)anel.cap / (1024 * 1024), anel.rebobinadas);
+}
+
+// ================================================================
+// PLACAR (recordes num arquivo mapeado em memória)
+// ----------------------------------------------------------------
+// Quem joga só põe o registro numa fila sem trava (registrarNoPlacar);
+// a thread do placar tira da fila, acrescenta no arquivo, confirma no
+// cabeçalho e publica a posição. O índice mora no próprio arquivo,
+// depois dos registros: uma base ordenada (os 'ordenados' primeiros
+// registros) mais o delta dos confirmados que vieram depois. Posição =
+// busca binária na base + contagem no delta; o delta é fundido na base
+// a cada PLACAR_DELTA registros. Abrir não ordena nada.
+// Tudo que lê ou muda o arquivo fica sob flock, porque outro processo
+// pode usar o mesmo --placar ao mesmo tempo.
+// ================================================================
+size_t tamanhoPlacar(size_t cap)
+{
+    return sizeof(CabecalhoPlacar) + (sizeof(RegistroPlacar) + sizeof(uint32_t)) * cap;
+}
+
+// Mapeia o arquivo para 'cap' registros (e o índice logo depois deles)
+int mapearPlacar(size_t cap)
+{
+    void *mapa = mmap(NULL, tamanhoPlacar(cap), PROT_READ | PROT_WRITE, MAP_SHARED, placar.fd, 0);
+    if (mapa == MAP_FAILED)
+        return 0;
+    placar.cab = (CabecalhoPlacar *)mapa;
+    placar.reg = (RegistroPlacar *)(placar.cab + 1);
+    placar.ordem = (uint32_t *)(placar.reg + cap);
+    placar.capacidade = cap;
+    return 1;
+}
+
+// Outro processo com o mesmo --placar pode ter crescido o arquivo (e
+// mudado o índice de lugar): refaz o mapa. Chamar com o flock na mão.
+int acompanharPlacar(void)
+{
+    size_t cap = (size_t)placar.cab->capacidade;
+    if (cap == placar.capacidade)
+        return 1;
+    munmap(placar.cab, tamanhoPlacar(placar.capacidade));
+    return mapearPlacar(cap);
+}
+
+// msync de um trecho do mapa (o começo desce até a página)
+void sincronizarPlacar(const void *inicio, size_t bytes)
+{
+    size_t pagina = (size_t)sysconf(_SC_PAGESIZE);
+    size_t de = (size_t)((const char *)inicio - (const char *)placar.cab) & ~(pagina - 1);
+    size_t ate = (size_t)((const char *)inicio - (const char *)placar.cab) + bytes;
+    msync((char *)placar.cab + de, ate - de, MS_SYNC);
+}
+
+// Liga/desliga 'indiceEmObra' no disco. Ligado, quem abrir refaz o índice.
+void marcarIndice(uint32_t emObra)
+{
+    placar.cab->indiceEmObra = emObra;
+    msync(placar.cab, sizeof(CabecalhoPlacar), MS_SYNC);
+}
+
+// Ordena todos os confirmados do zero: arquivo da versão 1 ou fusão
+// interrompida. O(n log n), só nesses casos.
+void refazerIndice(void)
+{
+    uint64_t n = placar.cab->confirmados;
+    marcarIndice(1);
+    for (uint64_t i = 0; i < n; i++)
+        placar.ordem[i] = (uint32_t)i;
+    qsort(placar.ordem, n, sizeof(uint32_t), compararPlacar);
+    sincronizarPlacar(placar.ordem, sizeof(uint32_t) * n);
+    placar.cab->ordenados = n;
+    marcarIndice(0);
+}
+
+// Abre (ou cria) o arquivo. O índice já está nele; só é refeito se o
+// arquivo é da versão 1 ou se uma fusão ficou pela metade. 0 se não deu.
+int abrirPlacar(const char *caminho)
+{
+    placar.fd = open(caminho, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (placar.fd < 0 || flock(placar.fd, LOCK_EX) < 0 || fstat(placar.fd, &st) < 0)
+    {
+        perror(caminho);
+        return 0;
+    }
+    size_t bytes = (size_t)st.st_size;
+    CabecalhoPlacar lido;
+    if (bytes == 0)
+    {
+        if (ftruncate(placar.fd, (off_t)tamanhoPlacar(PLACAR_CAP_INICIAL)) < 0 ||
+            !mapearPlacar(PLACAR_CAP_INICIAL))
+        {
+            perror(caminho);
+            return 0;
+        }
+        memcpy(placar.cab->magica, PLACAR_MAGICA, 4);
+        placar.cab->versao = PLACAR_VERSAO;
+        placar.cab->confirmados = 0;
+        placar.cab->capacidade = PLACAR_CAP_INICIAL;
+        placar.cab->ordenados = 0;
+        placar.cab->indiceEmObra = 0;
+        msync(placar.cab, sizeof(CabecalhoPlacar), MS_SYNC);
+    }
+    else if (bytes < sizeof lido || pread(placar.fd, &lido, sizeof lido, 0) != (ssize_t)sizeof lido ||
+             memcmp(lido.magica, PLACAR_MAGICA, 4) != 0)
+    {
+        fprintf(stderr, "%s: não é um placar do River Raid.\n", caminho);
+        return 0;
+    }
+    else if (lido.versao == 1)
+    {
+        // Versão 1: só registros, sem índice. Cresce o arquivo para caber
+        // o índice depois deles e marca para refazer.
+        size_t cap = (bytes - sizeof(CabecalhoPlacar)) / sizeof(RegistroPlacar);
+        if (lido.confirmados > cap)
+        {
+            fprintf(stderr, "%s: placar corrompido.\n", caminho);
+            return 0;
+        }
+        if (ftruncate(placar.fd, (off_t)tamanhoPlacar(cap)) < 0 || !mapearPlacar(cap))
+        {
+            perror(caminho);
+            return 0;
+        }
+        placar.cab->capacidade = cap;
+        placar.cab->ordenados = 0;
+        placar.cab->indiceEmObra = 1;
+        msync(placar.cab, sizeof(CabecalhoPlacar), MS_SYNC);
+        placar.cab->versao = PLACAR_VERSAO;
+        msync(placar.cab, sizeof(CabecalhoPlacar), MS_SYNC);
+    }
+    else if (lido.versao != PLACAR_VERSAO || lido.capacidade == 0 ||
+             lido.capacidade > (bytes - sizeof(CabecalhoPlacar)) / (sizeof(RegistroPlacar) + sizeof(uint32_t)) ||
+             lido.confirmados > lido.capacidade || lido.ordenados > lido.confirmados)
+    {
+        fprintf(stderr, "%s: não é um placar do River Raid (ou é de outra versão).\n", caminho);
+        return 0;
+    }
+    else if (!mapearPlacar((size_t)lido.capacidade))
+    {
+        fprintf(stderr, "%s: não deu para mapear o placar.\n", caminho);
+        return 0;
+    }
+
+    if (placar.cab->indiceEmObra || placar.cab->confirmados - placar.cab->ordenados > PLACAR_RASCUNHO)
+        refazerIndice();
+    flock(placar.fd, LOCK_UN);
+    placar.descargas = 0;
+    return 1;
+}
+
+// Arquivo maior (dobra até caber 'precisa' registros), mapa refeito e
+// índice levado para depois dos registros. Chamar com o flock na mão.
+int crescerPlacar(size_t precisa)
+{
+    size_t antes = placar.capacidade, cap = antes;
+    while (cap < precisa)
+        cap *= 2;
+    if (ftruncate(placar.fd, (off_t)tamanhoPlacar(cap)) < 0)
+        return 0;
+    munmap(placar.cab, tamanhoPlacar(antes));
+    if (!mapearPlacar(cap))
+        return 0;
+    uint64_t n = placar.cab->ordenados;
+    marcarIndice(1);
+    memmove(placar.ordem, placar.reg + antes, sizeof(uint32_t) * n);
+    sincronizarPlacar(placar.ordem, sizeof(uint32_t) * n);
+    placar.cab->capacidade = cap;
+    marcarIndice(0);
+    return 1;
+}
+
+void fecharPlacar(void)
+{
+    munmap(placar.cab, tamanhoPlacar(placar.capacidade));
+    close(placar.fd);
+}
+
+// Maior score primeiro; no empate, quem chegou antes
+int compararPlacar(const void *a, const void *b)
+{
+    uint32_t i = *(const uint32_t *)a, k = *(const uint32_t *)b;
+    int64_t si = placar.reg[i].score, sk = placar.reg[k].score;
+    if (si != sk)
+        return si > sk ? -1 : 1;
+    return (i > k) - (i < k);
+}
+
+// Delta (os confirmados depois da base) em ordem, no rascunho; devolve
+// quantos são
+long ordenarDelta(void)
+{
+    long base = (long)placar.cab->ordenados;
+    long k = (long)placar.cab->confirmados - base;
+    for (long i = 0; i < k; i++)
+        placar.delta[i] = (uint32_t)(base + i);
+    qsort(placar.delta, k, sizeof(uint32_t), compararPlacar);
+    return k;
+}
+
+// Funde o delta na base, de trás para a frente (sem cópia extra). Só o
+// trecho da base que mudou vai para o disco; se cair no meio, a próxima
+// abertura vê 'indiceEmObra' e refaz. Chamar com o flock na mão.
+void fundirDelta(void)
+{
+    if (placar.cab->confirmados - placar.cab->ordenados > PLACAR_RASCUNHO)
+    {
+        refazerIndice();
+        return;
+    }
+    long k = ordenarDelta();
+    if (k == 0)
+        return;
+    long total = (long)placar.cab->ordenados + k;
+    marcarIndice(1);
+    long i = (long)placar.cab->ordenados - 1, w = total - 1;
+    for (long d = k - 1; d >= 0; w--)
+    {
+        if (i >= 0 && compararPlacar(&placar.ordem[i], &placar.delta[d]) > 0)
+            placar.ordem[w] = placar.ordem[i--];
+        else
+            placar.ordem[w] = placar.delta[d--];
+    }
+    sincronizarPlacar(&placar.ordem[w + 1], sizeof(uint32_t) * (total - (w + 1)));
+    placar.cab->ordenados = (uint64_t)total;
+    marcarIndice(0);
+}
+
+// 1 + quantos registros têm score maior: O(log n) na base + o delta
+long posicaoNoPlacar(int64_t score)
+{
+    long lo = 0, hi = (long)placar.cab->ordenados;
+    while (lo < hi)
+    {
+        long meio = (lo + hi) / 2;
+        if (placar.reg[placar.ordem[meio]].score > score)
+            lo = meio + 1;
+        else
+            hi = meio;
+    }
+    for (uint64_t i = placar.cab->ordenados; i < placar.cab->confirmados; i++)
+        if (placar.reg[i].score > score)
+            lo++;
+    return lo + 1;
+}
+
+// Acrescenta n registros: primeiro eles vão para o disco, depois o
+// cabeçalho que os confirma. Se cair no meio, o arquivo continua valendo.
+// O flock serializa com outros processos que usam o mesmo arquivo: o
+// acréscimo vai para depois do que eles confirmaram, e a posição
+// publicada conta os registros deles.
+void anexarNoPlacar(const RegistroPlacar *r, int n)
+{
+    flock(placar.fd, LOCK_EX);
+    uint64_t c = 0;
+    if (!acompanharPlacar() ||
+        (c = placar.cab->confirmados) > placar.capacidade ||
+        (c + n > placar.capacidade && !crescerPlacar(c + n)))
+    {
+        flock(placar.fd, LOCK_UN);
+        atomic_fetch_add(&placar.perdidos, n);
+        return;
+    }
+    memcpy(&placar.reg[c], r, sizeof(RegistroPlacar) * n);
+    sincronizarPlacar(&placar.reg[c], sizeof(RegistroPlacar) * n);
+    placar.cab->confirmados = c + n;
+    msync(placar.cab, sizeof(CabecalhoPlacar), MS_SYNC);
+    placar.descargas++;
+
+    if (placar.cab->confirmados - placar.cab->ordenados >= PLACAR_DELTA)
+        fundirDelta();
+    atomic_store(&placar.ultimaPosicao, posicaoNoPlacar(r[n - 1].score));
+    atomic_store(&placar.total, (long)placar.cab->confirmados);
+    flock(placar.fd, LOCK_UN);
+}
+
+// Põe um registro na fila (qualquer thread, sem trava nem espera).
+// 0 se a fila está cheia.
+int registrarNoPlacar(int64_t score, uint64_t s, long passo, unsigned origem)
+{
+    unsigned long pos = atomic_load_explicit(&placar.cauda, memory_order_relaxed);
+    for (;;)
+    {
+        VagaPlacar *v = &placar.fila[pos & (PLACAR_FILA - 1)];
+        unsigned long seq = atomic_load_explicit(&v->seq, memory_order_acquire);
+        long dif = (long)(seq - pos);
+        if (dif < 0)
+            return 0; // a thread do placar ainda não liberou esta vaga
+        if (dif > 0)
+        {
+            pos = atomic_load_explicit(&placar.cauda, memory_order_relaxed);
+            continue; // outra thread pegou a vaga
+        }
+        if (atomic_compare_exchange_weak_explicit(&placar.cauda, &pos, pos + 1,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        {
+            v->r = (RegistroPlacar){score, s, (int64_t)time(NULL), (uint32_t)passo, origem};
+            atomic_store_explicit(&v->seq, pos + 1, memory_order_release);
+            atomic_fetch_add(&placar.enviados, 1);
+            return 1;
+        }
+    }
+}
+
+// Só a thread do placar tira da fila
+int tirarDoPlacar(RegistroPlacar *r)
+{
+    VagaPlacar *v = &placar.fila[placar.cabeca & (PLACAR_FILA - 1)];
+    if (atomic_load_explicit(&v->seq, memory_order_acquire) != placar.cabeca + 1)
+        return 0;
+    *r = v->r;
+    atomic_store_explicit(&v->seq, placar.cabeca + PLACAR_FILA, memory_order_release);
+    placar.cabeca++;
+    return 1;
+}
+
+// Thread do placar: esvazia a fila em lotes, grava e publica a posição
+// do último registro (o HUD mostra na morte)
+void *lacoPlacar(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        int parar = atomic_load(&placar.parar); // antes de esvaziar: nada fica para trás
+        int n = 0;
+        while (n < PLACAR_FILA && tirarDoPlacar(&placar.pegos[n]))
+            n++;
+        if (n > 0)
+        {
+            anexarNoPlacar(placar.pegos, n); // publica posição e total
+            atomic_fetch_add(&placar.processados, n);
+        }
+        else if (parar)
+            break;
+        else
+            dormirAte(agoraNs() + PLACAR_ESPERA_NS);
+    }
+    return NULL;
+}
+
+void iniciarPlacar(void)
+{
+    if (!caminhoPlacar)
+        return;
+    if (!abrirPlacar(caminhoPlacar))
+        exit(1);
+    for (unsigned long i = 0; i < PLACAR_FILA; i++)
+        atomic_init(&placar.fila[i].seq, i);
+    atomic_init(&placar.cauda, 0);
+    placar.cabeca = 0;
+    atomic_init(&placar.parar, 0);
+    atomic_init(&placar.enviados, 0);
+    atomic_init(&placar.processados, 0);
+    atomic_init(&placar.ultimaPosicao, 0);
+    atomic_init(&placar.total, (long)placar.cab->confirmados);
+    atomic_init(&placar.perdidos, 0);
+    if (pthread_create(&placar.thread, NULL, lacoPlacar, NULL) != 0)
+    {
+        fprintf(stderr, "placar: não deu para criar a thread.\n");
+        exit(1);
+    }
+    placarLigado = 1;
+}
+
+// Espera a fila esvaziar, mostra o resumo e fecha (depois do endwin)
+void finalizarPlacar(void)
+{
+    if (!placarLigado)
+        return;
+    atomic_store(&placar.parar, 1);
+    pthread_join(placar.thread, NULL);
+    placarLigado = 0;
+
+    // Sai com o delta fundido: a próxima abertura acha tudo na base
+    flock(placar.fd, LOCK_EX);
+    if (acompanharPlacar())
+        fundirDelta();
+    long n = (long)placar.cab->confirmados;
+    int64_t melhor = n > 0 ? placar.reg[placar.ordem[0]].score : 0;
+    flock(placar.fd, LOCK_UN);
+
+    long novos = atomic_load(&placar.processados);
+    printf("placar %s: %ld registros (+%ld nesta execucao, %ld descargas)",
+           caminhoPlacar, n, novos, placar.descargas);
+    if (n > 0)
+        printf("; melhor score %lld", (long long)melhor);
+    if (novos > 0 && nLote == 0)
+        printf("; ultimo ficou em #%ld", atomic_load(&placar.ultimaPosicao));
+    printf("\n");
+    if (atomic_load(&placar.perdidos) > 0)
+        printf("placar: %ld registros perdidos (fila cheia ou disco)\n", atomic_load(&placar.perdidos));
+    fecharPlacar();
+}
+
+// --placar-top K: os K melhores, sem jogar. Base e delta ordenado são
+// lidos juntos como numa fusão, só até K: O(K + delta log delta).
+int listarPlacar(long k)
+{
+    if (!abrirPlacar(caminhoPlacar))
+        return 1;
+    flock(placar.fd, LOCK_SH); // outro processo pode estar fundindo
+    if (!acompanharPlacar())
+    {
+        fprintf(stderr, "%s: não deu para mapear o placar.\n", caminhoPlacar);
+        return 1;
+    }
+    long n = (long)placar.cab->confirmados;
+    long nBase = (long)placar.cab->ordenados, nDelta = ordenarDelta();
+    if (k > n)
+        k = n;
+    printf("placar %s: %ld registros\n", caminhoPlacar, n);
+    printf("  %6s %10s %8s %20s  %-16s %s\n", "#", "score", "passo", "semente", "quando", "origem");
+    const char *origens[] = {"tela", "headless", "lote"};
+    long b = 0, d = 0;
+    for (long i = 0; i < k; i++)
+    {
+        int daBase = d == nDelta || (b < nBase && compararPlacar(&placar.ordem[b], &placar.delta[d]) < 0);
+        const RegistroPlacar *r = &placar.reg[daBase ? placar.ordem[b++] : placar.delta[d++]];
+        char quando[32];
+        time_t t = (time_t)r->quando;
+        strftime(quando, sizeof quando, "%Y-%m-%d %H:%M", localtime(&t));
+        printf("  %6ld %10lld %8u %20llu  %-16s %s%s\n", i + 1, (long long)r->score, r->passo,
+               (unsigned long long)r->semente, quando, origens[(r->origem & 3) % 3],
+               (r->origem & ORIGEM_PILOTO) ? "+piloto" : "");
+    }
+    flock(placar.fd, LOCK_UN);
+    fecharPlacar();
+    return 0;
+}
+
+// ================================================================
+// TELEMETRIA (eventos do jogo em binário)
+// ----------------------------------------------------------------
+// No passo, um evento custa uma escrita no anel e um store com
+// release. A thread de descarga lê a cabeça com acquire, escreve a
+// fatia pronta com fwrite e devolve o espaço movendo a cauda. O
+// produtor só relê a cauda quando acha o anel cheio.
+// ================================================================
+void emitirEvento(const Jogo *j, int tipo, int causa, int x, int y, long valor)
+{
+    Telemetria *t = j->eventos;
+    if (!t)
+        return;
+    unsigned long cabeca = atomic_load_explicit(&t->cabeca, memory_order_relaxed);
+    if (cabeca - t->caudaVista == EVENTOS_ANEL)
+    {
+        t->caudaVista = atomic_load_explicit(&t->cauda, memory_order_acquire);
+        if (cabeca - t->caudaVista == EVENTOS_ANEL)
+        {
+            t->transbordos++; // o jogo não espera: o evento se perde
+            return;
+        }
+    }
+    Evento *e = &t->anel[cabeca & (EVENTOS_ANEL - 1)];
+    e->partida = t->partida;
+    e->passo = (uint32_t)(j->contadorLinha - j->inicioVida);
+    e->valor = (int32_t)valor;
+    e->x = (int16_t)x;
+    e->y = (int16_t)y;
+    e->tipo = (uint8_t)tipo;
+    e->causa = (uint8_t)causa;
+    e->reservado = 0;
+    atomic_store_explicit(&t->cabeca, cabeca + 1, memory_order_release);
+}
+
+// Grava o que está pronto no anel (até duas fatias, por causa da volta).
+// 0 se estava vazio.
+int descarregarAnel(Telemetria *t)
+{
+    unsigned long cauda = atomic_load_explicit(&t->cauda, memory_order_relaxed);
+    unsigned long cabeca = atomic_load_explicit(&t->cabeca, memory_order_acquire);
+    if (cabeca == cauda)
+        return 0;
+    unsigned long n = cabeca - cauda;
+    unsigned long inicio = cauda & (EVENTOS_ANEL - 1);
+    unsigned long fatia = EVENTOS_ANEL - inicio < n ? EVENTOS_ANEL - inicio : n;
+    fwrite(&t->anel[inicio], sizeof(Evento), fatia, arquivoEventos);
+    fwrite(t->anel, sizeof(Evento), n - fatia, arquivoEventos);
+    atomic_store_explicit(&t->cauda, cabeca, memory_order_release);
+    eventosGravados += (long long)n;
+    return 1;
+}
+
+void *lacoDescarga(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        int parar = atomic_load(&pararDescarga); // antes de esvaziar: nada fica para trás
+        int algum = 0;
+        for (int i = 0; i < nAneisEventos; i++)
+            algum |= descarregarAnel(&aneisEventos[i]);
+        if (algum)
+            continue;
+        if (parar)
+            break;
+        dormirAte(agoraNs() + EVENTOS_ESPERA_NS);
+    }
+    return NULL;
+}
+
+// Abre o arquivo e cria um anel por thread que joga (antes do ncurses)
+void iniciarEventos(int nAneis)
+{
+    if (!caminhoEventos)
+        return;
+    arquivoEventos = fopen(caminhoEventos, "wb");
+    if (!arquivoEventos)
+    {
+        if (!modoHeadless && nLote == 0)
+            endwin();
+        perror(caminhoEventos);
+        exit(1);
+    }
+    fwrite(EVENTOS_MAGICA, 1, 4, arquivoEventos);
+    escreverU32(arquivoEventos, EVENTOS_VERSAO);
+    escreverU64(arquivoEventos, semente);
+    escreverU32(arquivoEventos, (uint32_t)LARGURA);
+    escreverU32(arquivoEventos, (uint32_t)ALTURA);
+    escreverU64(arquivoEventos, 0); // eventos e transbordos: finalizarEventos
+    escreverU64(arquivoEventos, 0);
+
+    aneisEventos = (Telemetria *)aligned_alloc(64, sizeof(Telemetria) * nAneis);
+    if (!aneisEventos)
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+    for (int i = 0; i < nAneis; i++)
+    {
+        Telemetria *t = &aneisEventos[i];
+        t->anel = (Evento *)malloc(sizeof(Evento) * EVENTOS_ANEL);
+        if (!t->anel)
+        {
+            fprintf(stderr, "Falha ao alocar memória.\n");
+            exit(1);
+        }
+        atomic_init(&t->cabeca, 0);
+        atomic_init(&t->cauda, 0);
+        t->caudaVista = 0;
+        t->partida = 0;
+        t->transbordos = 0;
+    }
+    nAneisEventos = nAneis;
+    eventosGravados = 0;
+    atomic_init(&pararDescarga, 0);
+    if (pthread_create(&threadDescarga, NULL, lacoDescarga, NULL) != 0)
+    {
+        fprintf(stderr, "eventos: não deu para criar a thread de descarga.\n");
+        exit(1);
+    }
+}
+
+// Anel da thread i, ou NULL sem --eventos
+Telemetria *anelDeEventos(int i)
+{
+    return i < nAneisEventos ? &aneisEventos[i] : NULL;
+}
+
+// Depois que os produtores pararam: esvazia, completa o cabeçalho e fecha
+void finalizarEventos(void)
+{
+    if (!arquivoEventos)
+        return;
+    atomic_store(&pararDescarga, 1);
+    pthread_join(threadDescarga, NULL);
+
+    long transbordos = 0;
+    for (int i = 0; i < nAneisEventos; i++)
+    {
+        transbordos += aneisEventos[i].transbordos;
+        free(aneisEventos[i].anel);
+    }
+    free(aneisEventos);
+    aneisEventos = NULL;
+    nAneisEventos = 0;
+
+    fseek(arquivoEventos, 24, SEEK_SET); // depois de magica, versão, semente e mundo
+    escreverU64(arquivoEventos, (uint64_t)eventosGravados);
+    escreverU64(arquivoEventos, (uint64_t)transbordos);
+    fclose(arquivoEventos);
+    arquivoEventos = NULL;
+    printf("eventos %s: %lld gravados, %ld perdidos (anel cheio)\n",
+           caminhoEventos, eventosGravados, transbordos);
+}
+
+// --ler-eventos ARQ: um evento por linha e, no fim, o resumo
+int lerEventos(const char *caminho)
+{
+    FILE *f = fopen(caminho, "rb");
+    if (!f)
+    {
+        perror(caminho);
+        return 1;
+    }
+    char magica[4];
+    uint32_t versao, largura, altura;
+    uint64_t s, total, transbordos;
+    if (fread(magica, 1, 4, f) != 4 || memcmp(magica, EVENTOS_MAGICA, 4) != 0 ||
+        !lerU32(f, &versao) || !lerU64(f, &s) || !lerU32(f, &largura) || !lerU32(f, &altura) ||
+        !lerU64(f, &total) || !lerU64(f, &transbordos))
+    {
+        fprintf(stderr, "%s: não é um arquivo de eventos do River Raid.\n", caminho);
+        fclose(f);
+        return 1;
+    }
+    if (versao != EVENTOS_VERSAO)
+    {
+        fprintf(stderr, "%s: versão %u do arquivo de eventos não suportada.\n", caminho, versao);
+        fclose(f);
+        return 1;
+    }
+
+    const char *nomes[NEVENTOS] = {"?", "abate", "coleta", "morte", "inimigo",
+                                   "posto", "acelera", "recomeco", "volta"};
+    const char *causas[NCAUSAS] = {"", "margem", "inimigo", "combustivel"};
+    long long porTipo[NEVENTOS] = {0};
+    long long mortes[NCAUSAS] = {0}, passoMorte[NCAUSAS] = {0}, scoreMorte[NCAUSAS] = {0};
+    long long lidos = 0;
+
+    printf("# partida passo_na_vida tipo x y valor causa\n");
+    Evento bloco[4096];
+    size_t n;
+    while ((n = fread(bloco, sizeof(Evento), 4096, f)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const Evento *e = &bloco[i];
+            int tipo = e->tipo < NEVENTOS ? e->tipo : 0;
+            int causa = e->causa < NCAUSAS ? e->causa : 0;
+            printf("%u %u %s %d %d %d %s\n", e->partida, e->passo, nomes[tipo],
+                   e->x, e->y, e->valor, causas[causa]);
+            porTipo[tipo]++;
+            if (tipo == EVENTO_MORTE)
+            {
+                mortes[causa]++;
+                passoMorte[causa] += e->passo;
+                scoreMorte[causa] += e->valor;
+            }
+        }
+        lidos += (long long)n;
+    }
+    fclose(f);
+
+    printf("# eventos %s: semente %llu, mundo %ux%u, %lld eventos (%llu perdidos com o anel cheio)%s\n",
+           caminho, (unsigned long long)s, largura, altura, lidos,
+           (unsigned long long)transbordos,
+           total == (uint64_t)lidos ? "" : " -- arquivo não foi fechado direito");
+    printf("#");
+    for (int t = 1; t < NEVENTOS; t++)
+        printf(" %s %lld", nomes[t], porTipo[t]);
+    printf("\n");
+    for (int c = 1; c < NCAUSAS; c++)
+        if (mortes[c] > 0)
+            printf("# morte por %-11s %8lld  passo medio na vida %8.1f  score medio %7.1f\n",
+                   causas[c], mortes[c], (double)passoMorte[c] / mortes[c],
+                   (double)scoreMorte[c] / mortes[c]);
+    return 0;
+}
+
+// ================================================================
+// LOTE (várias partidas independentes em paralelo)
+// ----------------------------------------------------------------
+// A partida k usa a semente semente + k e vai até a primeira morte (ou
+// --quadros passos). Cada thread reaproveita o seu Jogo de partida em
+// partida; fora as faixas, nada é escrito por duas threads. Como os
+// resultados ficam no índice da partida, o relatório é o mesmo com
+// qualquer número de threads.
+// ================================================================
+uint64_t faixaLote(uint32_t inicio, uint32_t fim)
+{
+    return ((uint64_t)inicio << 32) | fim;
+}
+
+// Próxima partida da própria faixa, ou -1 se acabou
+long tirarDaFaixa(TrabalhadorLote *t)
+{
+    unsigned long long v = atomic_load(&t->faixa);
+    for (;;)
+    {
+        uint32_t inicio = (uint32_t)(v >> 32), fim = (uint32_t)v;
+        if (inicio >= fim)
+            return -1;
+        if (atomic_compare_exchange_weak(&t->faixa, &v, faixaLote(inicio + 1, fim)))
+            return inicio;
+    }
+}
+
+// Corta a metade final da faixa da vítima (pelo menos 1 partida)
+int roubarFaixa(TrabalhadorLote *vitima, uint32_t *inicio, uint32_t *fim)
+{
+    unsigned long long v = atomic_load(&vitima->faixa);
+    for (;;)
+    {
+        uint32_t a = (uint32_t)(v >> 32), b = (uint32_t)v;
+        if (a >= b)
+            return 0;
+        uint32_t meio = b - (b - a + 1) / 2;
+        if (atomic_compare_exchange_weak(&vitima->faixa, &v, faixaLote(a, meio)))
+        {
+            *inicio = meio;
+            *fim = b;
+            return 1;
+        }
+    }
+}
+
+// Com piloto (pl != NULL), ele escolhe as ações; senão, entradaHeadless
+void jogarPartidaLote(Jogo *j, Piloto *pl, long k)
+{
+    if (j->eventos)
+        j->eventos->partida = (uint32_t)k;
+    novaPartida(j, semente + (uint64_t)k);
+    if (pl)
+        semearPiloto(pl, semente + (uint64_t)k);
+    long n = 0;
+    while (j->jogador.vivo && n < quadrosHeadless)
+    {
+        atualizarJogo(j, pl ? decidirPiloto(pl, j) : entradaHeadless(j, n));
+        n++;
+    }
+    scoreLote[k] = j->jogador.score;
+    quadrosLote[k] = n;
+    // Fora do laço de quadros: com a fila cheia, espera a thread do placar
+    while (placarLigado &&
+           !registrarNoPlacar(j->jogador.score, semente + (uint64_t)k, n,
+                              ORIGEM_LOTE | (pl ? ORIGEM_PILOTO : 0)))
+        sched_yield();
+}
+
+void *trabalharLote(void *arg)
+{
+    TrabalhadorLote *t = (TrabalhadorLote *)arg;
+    Jogo *j = (Jogo *)calloc(1, sizeof(Jogo));
+    Piloto *pl = pilotoLigado ? (Piloto *)calloc(1, sizeof(Piloto)) : NULL;
+    if (!j || !alocarJogo(j) || (pilotoLigado && (!pl || !iniciarPiloto(pl))))
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+    j->eventos = anelDeEventos(t->id);
+    Rng rngVitima; // onde começar a procurar o que roubar
+    rngSemear(&rngVitima, semente, 100 + (uint64_t)t->id);
+
+    for (;;)
+    {
+        long k = tirarDaFaixa(t);
+        if (k < 0)
+        {
+            // Sem trabalho: uma volta pelas outras threads; todas vazias = fim
+            uint32_t inicio = 0, fim = 0;
+            int achou = 0;
+            int primeira = rngAte(&rngVitima, threadsLote);
+            for (int v = 0; v < threadsLote && !achou; v++)
+            {
+                TrabalhadorLote *vitima = &trabalhadores[(primeira + v) % threadsLote];
+                if (vitima != t)
+                    achou = roubarFaixa(vitima, &inicio, &fim);
+            }
+            if (!achou)
+                break;
+            t->roubos++;
+            atomic_store(&t->faixa, faixaLote(inicio + 1, fim));
+            k = inicio;
+        }
+        jogarPartidaLote(j, pl, k);
+        t->partidas++;
+    }
+
+    if (pl)
+    {
+        t->nos = pl->nos;
+        liberarPiloto(pl);
+        free(pl);
+    }
+    liberarJogo(j);
+    free(j);
+    return NULL;
+}
+
+// Média e percentis (ordena v)
+void imprimirDistribuicao(const char *nome, long *v, long n)
+{
+    qsort(v, n, sizeof v[0], compararLong);
+    double soma = 0;
+    for (long i = 0; i < n; i++)
+        soma += v[i];
+    printf("  %-8s %10.1f %8ld %8ld %8ld %8ld %8ld\n", nome, soma / n,
+           v[0], v[n / 2], v[(n * 9) / 10], v[(n * 99) / 100], v[n - 1]);
+}
+
+int rodarLote(void)
+{
+    if (LARGURA == 0)
+        LARGURA = 80;
+    if (ALTURA == 0)
+        ALTURA = 24;
+    if (ALTURA < 20 || LARGURA < 40)
+    {
+        fprintf(stderr, "O campo virtual precisa ter pelo menos 40x20.\n");
+        return 1;
+    }
+    definirLimitesDoRio();
+
+    if (threadsLote == 0)
+        threadsLote = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadsLote < 1)
+        threadsLote = 1;
+    if (threadsLote > LOTE_MAX_THREADS)
+        threadsLote = LOTE_MAX_THREADS;
+    if (threadsLote > nLote)
+        threadsLote = (int)nLote;
+
+    iniciarEventos(threadsLote);
+    trabalhadores = (TrabalhadorLote *)aligned_alloc(64, sizeof(TrabalhadorLote) * threadsLote);
+    scoreLote = (long *)malloc(sizeof(long) * nLote);
+    quadrosLote = (long *)malloc(sizeof(long) * nLote);
+    if (!trabalhadores || !scoreLote || !quadrosLote)
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        return 1;
+    }
+
+    // Faixas iniciais do mesmo tamanho; o roubo equilibra o resto
+    for (int t = 0; t < threadsLote; t++)
+    {
+        TrabalhadorLote *w = &trabalhadores[t];
+        atomic_init(&w->faixa, faixaLote((uint32_t)(nLote * t / threadsLote),
+                                         (uint32_t)(nLote * (t + 1) / threadsLote)));
+        w->partidas = w->roubos = 0;
+        w->nos = 0;
+        w->id = t;
+    }
+
+    double inicio = agoraSegundos();
+    for (int t = 1; t < threadsLote; t++)
+        if (pthread_create(&trabalhadores[t].thread, NULL, trabalharLote, &trabalhadores[t]) != 0)
+        {
+            fprintf(stderr, "lote: não deu para criar a thread %d.\n", t);
+            return 1;
+        }
+    trabalharLote(&trabalhadores[0]); // a thread principal também joga
+    for (int t = 1; t < threadsLote; t++)
+        pthread_join(trabalhadores[t].thread, NULL);
+    double duracao = agoraSegundos() - inicio;
+
+    long long quadros = 0;
+    for (long k = 0; k < nLote; k++)
+        quadros += quadrosLote[k];
+    long menos = nLote, mais = 0, roubos = 0;
+    long long nos = 0;
+    for (int t = 0; t < threadsLote; t++)
+    {
+        const TrabalhadorLote *w = &trabalhadores[t];
+        if (w->partidas < menos)
+            menos = w->partidas;
+        if (w->partidas > mais)
+            mais = w->partidas;
+        roubos += w->roubos;
+        nos += w->nos;
+    }
+
+    printf("lote %dx%d semente %llu: %ld partidas em %.3f s com %d threads "
+           "(%.0f partidas/s, %.0f quadros/s)\n",
+           LARGURA, ALTURA, (unsigned long long)semente, nLote, duracao, threadsLote,
+           duracao > 0 ? nLote / duracao : 0.0, duracao > 0 ? quadros / duracao : 0.0);
+    printf("  %-8s %10s %8s %8s %8s %8s %8s\n", "", "media", "min", "p50", "p90", "p99", "max");
+    imprimirDistribuicao("score", scoreLote, nLote);
+    imprimirDistribuicao("quadros", quadrosLote, nLote);
+    printf("  partidas por thread: min %ld max %ld | roubos %ld\n", menos, mais, roubos);
+    if (pilotoLigado)
+        printf("  piloto: %lld nos (%.0f nos/s no total)\n", nos, duracao > 0 ? nos / duracao : 0.0);
+    finalizarPlacar();
+    finalizarEventos();
+
+    free(trabalhadores);
+    free(scoreLote);
+    free(quadrosLote);
+    return 0;
+}
+
+// ================================================================
+// BENCHMARKS (--bench NOME)
+// ----------------------------------------------------------------
+// Rodam sem terminal de verdade: o ncurses escreve em /dev/null.
+// ================================================================
+SCREEN *abrirTelaNula(int largura, int altura)
+{
+    const char *term = getenv("TERM");
+    if (!term || !term[0])
+        term = "xterm";
+
+    FILE *saida = fopen("/dev/null", "w");
+    FILE *arqEntrada = fopen("/dev/null", "r");
+    SCREEN *tela = (saida && arqEntrada) ? newterm(term, saida, arqEntrada) : NULL;
+    if (!tela)
+    {
+        fprintf(stderr, "bench: newterm falhou (TERM=%s)\n", term);
+        exit(1);
     }
+    resize_term(altura, largura);
+    scrollok(stdscr, TRUE);
+    idlok(stdscr, TRUE);
+    iniciarCores();
+    return tela;
 }
 
-void desenharTudo(const Player *p)
+void fecharTelaNula(SCREEN *tela)
 {
-    erase();       // limpa a tela virtual (ncurses usa double-buffering)
-    start_color(); // Permite o uso de cores
+    endwin();
+    delscreen(tela);
+}
 
-    init_pair(1, COLOR_GREEN, COLOR_BLACK);   // cor verde
-    init_pair(2, COLOR_YELLOW, COLOR_BLACK);  // cor amarelha
-    init_pair(3, COLOR_RED, COLOR_BLACK);     // cor vermelha
-    init_pair(4, COLOR_MAGENTA, COLOR_BLACK); // cor ciano
+// Mesmo começo de jogo em todas as medições
+void prepararBench(Jogo *j)
+{
+    novaPartida(j, 1); // rio novo, igual em todas as medições
+    rngBench = j->rngEntrada;
+}
+
+void passoBench(Jogo *j, long n)
+{
+    atualizarJogo(j, entradaHeadless(j, n));
+    if (!j->jogador.vivo)
+        atualizarJogo(j, ACAO_REINICIAR);
+}
+
+// Cópia do desenho antigo (erase, cores a cada quadro e um mvaddch por
+// célula), mantida só para comparar o número de chamadas ao ncurses.
+void desenharTudoOriginal(const Jogo *j)
+{
+    const Player *p = &j->jogador;
+    erase();
+    start_color();
+    init_pair(1, COLOR_GREEN, COLOR_BLACK);
+    init_pair(2, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(3, COLOR_RED, COLOR_BLACK);
+    init_pair(4, COLOR_MAGENTA, COLOR_BLACK);
     init_pair(5, COLOR_BLUE, COLOR_BLACK);
     init_pair(6, COLOR_BLACK, COLOR_YELLOW);
+    chamadasCurses += 8;
 
     for (int y = 0; y < ALTURA; y++)
     {
-        int L = margemEsq[y];
-        int R = margemDir[y];
-
-        // Parte sólida à esquerda (margem + "terra" fora do rio)
+        const LinhaRio *linha = linhaDoRio(j, y);
         attron(COLOR_PAIR(1));
-        for (int x = 0; x <= L; x++)
-        {
+        for (int x = 0; x <= linha->esq; x++)
             mvaddch(y, x, '#');
-        }
         attroff(COLOR_PAIR(1));
-        // Parte de água do rio (espaços em branco)
         attron(COLOR_PAIR(5));
-        for (int x = L + 1; x < R; x++)
-        {
+        for (int x = linha->esq + 1; x < linha->dir; x++)
             mvaddch(y, x, ' ');
-        }
-        attroff(COLOR_PAIR(1));
-        // Parte sólida à direita
+        attroff(COLOR_PAIR(5));
         attron(COLOR_PAIR(1));
-        for (int x = R; x < LARGURA; x++)
-        {
+        for (int x = linha->dir; x < LARGURA; x++)
             mvaddch(y, x, '#');
-        }
         attroff(COLOR_PAIR(1));
+        chamadasCurses += 6 + LARGURA;
     }
 
-    // Desenha o inimigo
     attron(COLOR_PAIR(3));
-    for (int i = 0; i < INIMIGOS_MAX; i++)
+    chamadasCurses += 2;
+    for (int i = 0; i < capInimigos; i++)
     {
-        if (inimigos[i].vivo)
-            desenharInimigo(&inimigos[i]);
+        if (!estaVivo(&j->inimigos, i))
+            continue;
+        for (int r = 0; r < INIMIGO_H; r++)
+        {
+            for (int c = 0; c < INIMIGO_W; c++)
+            {
+                int y = j->inimigos.y[i] + r;
+                if (INIMIGO[r][c] != ' ' && y < ALTURA)
+                {
+                    mvaddch(y, j->inimigos.x[i] + c, INIMIGO[r][c]);
+                    chamadasCurses++;
+                }
+            }
+        }
     }
     attroff(COLOR_PAIR(3));
 
     attron(COLOR_PAIR(4));
-    for (int i = 0; i < GASOLINA_MAX; i++)
+    chamadasCurses += 2;
+    for (int i = 0; i < capPostos; i++)
     {
-        if (postos[i].vivo)
+        if (estaVivo(&j->postos, i))
         {
-            mvprintw(postos[i].y, postos[i].x, "[FUEL]");
+            mvprintw(j->postos.y[i], j->postos.x[i], "[FUEL]");
+            chamadasCurses++;
         }
     }
     attroff(COLOR_PAIR(4));
 
     attron(COLOR_PAIR(2));
-    desenharBalas(); // desenha todas as balas na tela
-    attroff(COLOR_PAIR(2));
-
-    attron(COLOR_PAIR(2));
-    desenharAviao(p);
+    chamadasCurses += 4;
+    for (int b = 0; b < j->nBalas; b++)
+    {
+        mvaddch(j->balaY[b], j->balaX[b], '|');
+        chamadasCurses++;
+    }
+    for (int r = 0; r < AVIAO_H; r++)
+    {
+        for (int c = 0; c < AVIAO_W; c++)
+        {
+            if (AVIAO[r][c] != ' ')
+            {
+                mvaddch(p->y + r, p->x + c, p->vivo ? AVIAO[r][c] : 'X');
+                chamadasCurses++;
+            }
+        }
+    }
     attroff(COLOR_PAIR(2));
 
     attron(COLOR_PAIR(6));
     mvprintw(0, 2, "SCORE: %ld  FUEL: %d  %s  | ESPACO=tiro  Q=sair",
-             p->score, p->fuel,
-             p->vivo ? "" : "[MORREU — R=recomecar]");
+             p->score, p->fuel, p->vivo ? "" : "[MORREU - R=recomecar]");
     attroff(COLOR_PAIR(6));
-
     refresh();
+    chamadasCurses += 4;
 }
 
-// ================================================================
-// COLISÃO E RESET
-// ================================================================
-int haColisao(const Player *p)
+// Desenha 'quadros' quadros do jogo; mede só o tempo de desenho
+void medirDesenho(const char *nome, int original, long quadros)
 {
-    for (int r = 0; r < AVIAO_H; r++)
+    SCREEN *tela = abrirTelaNula(LARGURA, ALTURA);
+    alocarQuadros(LARGURA, ALTURA);
+
+    Jogo *j = &jogo;
+    prepararBench(j);
+    linhasNaTela = j->linhasRoladas;
+    chamadasCurses = 0;
+    celulasTotal = 0;
+    quadrosDesenhados = 0;
+
+    long long gasto = 0;
+    for (long n = 0; n < quadros; n++)
     {
-        int y = p->y + r;
-        if (y < 0 || y >= ALTURA)
-            continue;
-        for (int c = 0; c < AVIAO_W; c++)
+        passoBench(j, n);
+
+        long long t0 = agoraNs();
+        if (original)
+            desenharTudoOriginal(j);
+        else
+            desenharTudo(j);
+        gasto += agoraNs() - t0;
+    }
+
+    printf("  %-9s %10.1f chamadas/quadro %10.0f ns/quadro",
+           nome, (double)chamadasCurses / quadros, (double)gasto / quadros);
+    if (!original)
+        printf(" %8.1f celulas/quadro", (double)celulasTotal / quadros);
+    printf("\n");
+
+    liberarQuadros();
+    fecharTelaNula(tela);
+}
+
+int benchRender(void)
+{
+    if (LARGURA == 0)
+        LARGURA = 300;
+    if (ALTURA == 0)
+        ALTURA = 100;
+    alocarMundo();
+
+    long quadros = 2000;
+    printf("bench render %dx%d (%ld quadros)\n", LARGURA, ALTURA, quadros);
+    medirDesenho("original", 1, quadros);
+    medirDesenho("atual", 0, quadros);
+
+    liberarMundo();
+    return 0;
+}
+
+// Sorteia uma coluna de água na linha y (com folga 'largura' à direita)
+int colunaNaAgua(const Jogo *j, int y, int largura)
+{
+    const LinhaRio *linha = linhaDoRio(j, y);
+    int x = colunaLivre(&rngBench, linha, largura, 0);
+    return x >= 0 ? x : linha->esq + 1;
+}
+
+// Estresse de tiros x inimigos: tela cheia de inimigos e de balas, mede
+// só atualizarBalas. Para centenas de inimigos use --inimigos 1000; para
+// mais balas, compile com -DBALAS_MAX=1000.
+int benchBalas(void)
+{
+    if (LARGURA == 0)
+        LARGURA = 300;
+    if (ALTURA == 0)
+        ALTURA = 100;
+    alocarMundo();
+
+    Jogo *j = &jogo;
+    prepararBench(j);
+
+    int casosInimigos[] = {capInimigos / 4, capInimigos / 2, capInimigos};
+    int casosBalas[] = {BALAS_MAX / 8, BALAS_MAX / 2, BALAS_MAX};
+    int repeticoes = 2000;
+
+    printf("bench balas %dx%d (%d repeticoes; inimigos=%d BALAS_MAX=%d)\n",
+           LARGURA, ALTURA, repeticoes, capInimigos, BALAS_MAX);
+
+    for (int a = 0; a < 3; a++)
+    {
+        for (int b = 0; b < 3; b++)
         {
-            char ch = AVIAO[r][c];
-            if (ch == ' ')
-                continue;
-            int x = p->x + c;
-            if (x <= margemEsq[y] || x >= margemDir[y])
-                return 1;
+            int nInimigos = casosInimigos[a];
+            long long gasto = 0;
+            long candidatos = 0;
+            long balasMedidas = 0;
+
+            for (int rep = 0; rep < repeticoes; rep++)
+            {
+                ReiniciarInimigos(j);
+                for (int n = 0; n < nInimigos; n++)
+                {
+                    int i = pegarVaga(&j->inimigos.vagas);
+                    int y = rngAte(&rngBench, ALTURA - INIMIGO_H);
+                    nascer(&j->inimigos, i, colunaNaAgua(j, y, INIMIGO_W), y);
+                }
+                j->nBalas = casosBalas[b];
+                for (int k = 0; k < j->nBalas; k++)
+                {
+                    j->balaY[k] = 2 + rngAte(&rngBench, ALTURA - 2);
+                    j->balaX[k] = colunaNaAgua(j, j->balaY[k], 1);
+                }
+                indexarInimigos(j);
+
+                // Quantos inimigos cada bala vai olhar (depois de subir 1)
+                for (int k = 0; k < j->nBalas; k++)
+                {
+                    int y0 = j->balaY[k] - INIMIGO_H;
+                    candidatos += j->inicioLinha[j->balaY[k]] - j->inicioLinha[y0 < 0 ? 0 : y0];
+                }
+                balasMedidas += j->nBalas;
+
+                long long t0 = agoraNs();
+                atualizarBalas(j);
+                gasto += agoraNs() - t0;
+            }
+
+            printf("  inimigos %5d  balas %5d  %8.1f ns/bala  %6.2f testes/bala (linear: %d)\n",
+                   nInimigos, casosBalas[b], (double)gasto / balasMedidas,
+                   (double)candidatos / balasMedidas, capInimigos);
         }
     }
 
-    for (int r = 0; r < AVIAO_H; r++)
+    liberarMundo();
+    return 0;
+}
+
+// Layout antigo (vetor de structs com 'vivo'), só para comparação
+typedef struct
+{
+    int x, y, vivo;
+} EntidadeAoS;
+
+void moverAoS(EntidadeAoS *v, int n, ListaVagas *vagas)
+{
+    for (int i = 0; i < n; i++)
     {
-        int y = p->y + r;
-        if (y < 0 || y >= ALTURA)
-            continue;
-        for (int c = 0; c < AVIAO_W; c++)
+        if (v[i].vivo)
         {
-            char ch = AVIAO[r][c];
-            if (ch == ' ')
-                continue;
-            int x = p->x + c;
-            for (int i = 0; i < INIMIGOS_MAX; i++)
+            v[i].y++;
+            if (v[i].y >= ALTURA)
             {
-                if (inimigos[i].vivo &&
-                    x >= inimigos[i].x &&
-                    x < inimigos[i].x + INIMIGO_W &&
-                    y >= inimigos[i].y &&
-                    y < inimigos[i].y + INIMIGO_H)
-                    return 1;
+                v[i].vivo = 0;
+                devolverVaga(vagas, i);
             }
         }
     }
+}
+
+// Descida + corte das entidades: moverEntidades (SoA) x layout antigo
+int benchEntidades(void)
+{
+    if (ALTURA == 0)
+        ALTURA = 100;
+
+    int casos[] = {20, 1000, 100000};
+    int passosPorRodada = ALTURA / 2; // metade sai da tela a cada rodada
+
+#ifdef __SSE2__
+    const char *caminho = "SSE2";
+#else
+    const char *caminho = "escalar";
+#endif
+    printf("bench entidades (altura %d, %d passos por rodada, %s)\n",
+           ALTURA, passosPorRodada, caminho);
+
+    for (int c = 0; c < 3; c++)
+    {
+        int n = casos[c];
+        int rodadas = 20000000 / (n * passosPorRodada) + 1;
+
+        Entidades e;
+        EntidadeAoS *aos = (EntidadeAoS *)malloc(sizeof(EntidadeAoS) * n);
+        ListaVagas vagasAoS = {(int *)malloc(sizeof(int) * n), 0, 0};
+        if (!alocarEntidades(&e, n) || !aos || !vagasAoS.livres)
+        {
+            fprintf(stderr, "Falha ao alocar memória.\n");
+            return 1;
+        }
+
+        long long gastoSoA = 0, gastoAoS = 0;
+        for (int r = 0; r < rodadas; r++)
+        {
+            reiniciarEntidades(&e);
+            vagasAoS.nLivres = 0; // todas ocupadas abaixo
+            for (int i = 0; i < n; i++)
+            {
+                int y = rngAte(&rngBench, ALTURA);
+                nascer(&e, pegarVaga(&e.vagas), i % 200, y);
+                aos[i].x = i % 200;
+                aos[i].y = y;
+                aos[i].vivo = 1;
+            }
+
+            long long t0 = agoraNs();
+            for (int k = 0; k < passosPorRodada; k++)
+                moverEntidades(&e);
+            long long t1 = agoraNs();
+            for (int k = 0; k < passosPorRodada; k++)
+                moverAoS(aos, n, &vagasAoS);
+            long long t2 = agoraNs();
 
+            gastoSoA += t1 - t0;
+            gastoAoS += t2 - t1;
+        }
+
+        double passos = (double)rodadas * passosPorRodada;
+        printf("  %6d entidades  SoA %10.1f ns/passo (%.2f ns/ent)  AoS %10.1f ns/passo (%.2f ns/ent)  %.1fx\n",
+               n, gastoSoA / passos, gastoSoA / passos / n,
+               gastoAoS / passos, gastoAoS / passos / n,
+               gastoSoA > 0 ? (double)gastoAoS / gastoSoA : 0.0);
+
+        liberarEntidades(&e);
+        free(aos);
+        free(vagasAoS.livres);
+    }
     return 0;
 }
 
-void reiniciarJogo(Player *p)
+// ----------------------------------------------------------------
+// Núcleo: cada função quente isolada, em CSV (ns/op e ops/s).
+// Com --base ARQ, compara com um CSV gravado antes.
+// ----------------------------------------------------------------
+#define NUCLEO_ORCAMENTO_NS 20000000LL // tempo mínimo medido por caso
+#define NUCLEO_MIN_REPETICOES 50
+#define NUCLEO_MAX_LINHAS 256
+
+typedef struct
 {
-    tick_usec = TICK_START_USEC;
-    destruirBalas();
-    iniciarBalas();
-    criarRioInicial();
-    p->x = LARGURA / 2;
-    p->y = ALTURA - 4;
+    char funcao[16];
+    int largura, altura, balas, inimigos;
+    double nsOp;
+} LinhaNucleo;
+
+LinhaNucleo baseNucleo[NUCLEO_MAX_LINHAS];
+int nBaseNucleo = 0;
+long long custoRelogio = 0; // custo de um par agoraNs(), descontado das medições
+volatile int sumidouro;     // impede o compilador de descartar haColisao
+
+void lerBaseNucleo(const char *caminho)
+{
+    FILE *f = fopen(caminho, "r");
+    if (!f)
+    {
+        perror(caminho);
+        exit(1);
+    }
+    char linha[256];
+    while (fgets(linha, sizeof linha, f) && nBaseNucleo < NUCLEO_MAX_LINHAS)
+    {
+        LinhaNucleo *b = &baseNucleo[nBaseNucleo];
+        if (sscanf(linha, "%15[^,],%d,%d,%d,%d,%lf", b->funcao, &b->largura, &b->altura,
+                   &b->balas, &b->inimigos, &b->nsOp) == 6)
+            nBaseNucleo++;
+    }
+    fclose(f);
+}
+
+void calibrarRelogio(void)
+{
+    long long menor = -1;
+    for (int i = 0; i < 1000; i++)
+    {
+        long long t0 = agoraNs();
+        long long t1 = agoraNs();
+        if (menor < 0 || t1 - t0 < menor)
+            menor = t1 - t0;
+    }
+    custoRelogio = menor;
+}
+
+// Cena do caso: inimigos e balas espalhados pela água, índice pronto
+void preencherCena(Jogo *j, int nInimigos, int quantasBalas)
+{
+    ReiniciarInimigos(j);
+    for (int n = 0; n < nInimigos; n++)
+    {
+        int i = pegarVaga(&j->inimigos.vagas);
+        int y = rngAte(&rngBench, ALTURA - INIMIGO_H);
+        nascer(&j->inimigos, i, colunaNaAgua(j, y, INIMIGO_W), y);
+    }
+    j->nBalas = quantasBalas;
+    for (int k = 0; k < j->nBalas; k++)
+    {
+        j->balaY[k] = 2 + rngAte(&rngBench, ALTURA - 2);
+        j->balaX[k] = colunaNaAgua(j, j->balaY[k], 1);
+    }
+    indexarInimigos(j);
+}
+
+void imprimirNucleo(const char *funcao, int quantasBalas, int nInimigos, long long gasto, long ops)
+{
+    double nsOp = ops > 0 ? (double)gasto / ops : 0;
+    if (nsOp < 0.01)
+        nsOp = 0.01;
+    printf("%s,%d,%d,%d,%d,%.2f,%.0f", funcao, LARGURA, ALTURA, quantasBalas, nInimigos,
+           nsOp, 1e9 / nsOp);
+
+    if (caminhoBase)
+    {
+        for (int i = 0; i < nBaseNucleo; i++)
+        {
+            const LinhaNucleo *b = &baseNucleo[i];
+            if (strcmp(b->funcao, funcao) == 0 && b->largura == LARGURA && b->altura == ALTURA &&
+                b->balas == quantasBalas && b->inimigos == nInimigos)
+            {
+                printf(",%.2f,%.3f", b->nsOp, b->nsOp / nsOp);
+                break;
+            }
+        }
+    }
+    printf("\n");
+}
+
+void medirNucleo(int quantasBalas, int nInimigos)
+{
+    Jogo *j = &jogo;
+    Player *p = &j->jogador;
+    prepararBench(j);
+    for (long n = 0; n < 2 * ALTURA; n++)
+        passoBench(j, n); // rio já com curvas
     p->vivo = 1;
-    p->score = 0;
-    p->fuel = 100; // NOVO: tanque cheio
-    ReiniciarInimigos();
-    ReiniciarGasolina();
+    const int lote = 1000;
+
+    // gerarNovaLinhaNoTopo
+    long long gasto = 0, inicio = agoraNs();
+    long ops = 0;
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            gerarNovaLinhaNoTopo(j);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("rio", quantasBalas, nInimigos, gasto, ops);
+
+    // haColisao, com o avião varrendo a água
+    preencherCena(j, nInimigos, quantasBalas);
+    int vao = LARGURA - AVIAO_W - 2;
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+        {
+            p->x = 1 + k % vao;
+            sumidouro += haColisao(j);
+        }
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("haColisao", quantasBalas, nInimigos, gasto, ops);
+
+    // disparar, enchendo o vetor de balas do zero
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        j->nBalas = 0;
+        long long t0 = agoraNs();
+        for (int k = 0; k < BALAS_MAX; k++)
+        {
+            j->ultimoTiro = j->contadorLinha - cadenciaTiro;
+            disparar(j);
+        }
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += BALAS_MAX;
+    }
+    imprimirNucleo("disparar", quantasBalas, nInimigos, gasto, ops);
+
+    // atualizarBalas: uma chamada por cena montada
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        preencherCena(j, nInimigos, quantasBalas);
+        long long t0 = agoraNs();
+        atualizarBalas(j);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops++;
+    }
+    imprimirNucleo("atualizarBalas", quantasBalas, nInimigos, gasto, ops);
+
+    // desenharTudo: o rio rola 1 linha antes de cada quadro
+    preencherCena(j, nInimigos, quantasBalas);
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        gerarNovaLinhaNoTopo(j);
+        long long t0 = agoraNs();
+        desenharTudo(j);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops++;
+    }
+    imprimirNucleo("desenharTudo", quantasBalas, nInimigos, gasto, ops);
+
+    // copiarJogo: a cópia que o piloto faz a cada ensaio
+    Jogo *copia = (Jogo *)calloc(1, sizeof(Jogo));
+    if (!copia || !alocarJogo(copia))
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            copiarJogo(copia, j);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("copiarJogo", quantasBalas, nInimigos, gasto, ops);
+
+    // salvar/restaurarInstantaneo: o custo por passo do anel de rebobinar
+    Instantaneo *inst = (Instantaneo *)aligned_alloc(64, tamanhoInstantaneo(j));
+    if (!inst)
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            salvarInstantaneo(inst, j);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("salvarInstantaneo", quantasBalas, nInimigos, gasto, ops);
+
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            restaurarInstantaneo(copia, inst);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("restaurarInstantaneo", quantasBalas, nInimigos, gasto, ops);
+    free(inst);
+    liberarJogo(copia);
+    free(copia);
+
+    // atualizarJogo: o passo inteiro, com entrada sorteada e reinícios
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            passoBench(j, ops + k);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+    }
+    imprimirNucleo("atualizarJogo", quantasBalas, nInimigos, gasto, ops);
+
+    // emitirEvento: o custo no passo; a cauda anda a cada lote, como se
+    // a descarga acompanhasse
+    Telemetria t = {0};
+    t.anel = (Evento *)malloc(sizeof(Evento) * EVENTOS_ANEL);
+    if (!t.anel)
+    {
+        fprintf(stderr, "Falha ao alocar memória.\n");
+        exit(1);
+    }
+    j->eventos = &t;
+    gasto = 0, ops = 0, inicio = agoraNs();
+    while (agoraNs() - inicio < NUCLEO_ORCAMENTO_NS || ops < NUCLEO_MIN_REPETICOES)
+    {
+        long long t0 = agoraNs();
+        for (int k = 0; k < lote; k++)
+            emitirEvento(j, EVENTO_ABATE, 0, k, k, ops);
+        gasto += agoraNs() - t0 - custoRelogio;
+        ops += lote;
+        atomic_store(&t.cauda, atomic_load(&t.cabeca));
+    }
+    imprimirNucleo("emitirEvento", quantasBalas, nInimigos, gasto, ops);
+    j->eventos = NULL;
+    free(t.anel);
+}
+
+// Tamanhos de 40x20 a 400x150 (ou só --largura/--altura, se dados)
+int benchNucleo(void)
+{
+    int tamanhos[][2] = {{40, 20}, {80, 24}, {200, 60}, {400, 150}};
+    int nTamanhos = 4;
+    if (LARGURA > 0 && ALTURA > 0)
+    {
+        tamanhos[0][0] = LARGURA;
+        tamanhos[0][1] = ALTURA;
+        nTamanhos = 1;
+    }
+    int casosBalas[] = {16, BALAS_MAX};
+    int casosInimigos[] = {20, 1000};
+
+    if (caminhoBase)
+        lerBaseNucleo(caminhoBase);
+    calibrarRelogio();
+
+    printf("funcao,largura,altura,balas,inimigos,ns_op,ops_s%s\n",
+           caminhoBase ? ",base_ns_op,aceleracao" : "");
+
+    int capOriginal = capInimigos;
+    for (int t = 0; t < nTamanhos; t++)
+    {
+        LARGURA = tamanhos[t][0];
+        ALTURA = tamanhos[t][1];
+        for (int a = 0; a < 2; a++)
+        {
+            capInimigos = capOriginal > casosInimigos[a] ? capOriginal : casosInimigos[a];
+            alocarMundo();
+            SCREEN *tela = abrirTelaNula(LARGURA, ALTURA);
+            alocarQuadros(LARGURA, ALTURA);
+
+            for (int b = 0; b < 2; b++)
+                medirNucleo(casosBalas[b], casosInimigos[a]);
+
+            liberarQuadros();
+            fecharTelaNula(tela);
+            liberarMundo();
+        }
+    }
+    capInimigos = capOriginal;
+    return 0;
 }
 
-void ReiniciarInimigos(void)
+// ----------------------------------------------------------------
+// Placar: acréscimo (com msync e fusões do índice no arquivo), abertura
+// e posição pelo índice contra a contagem linear, de 10 mil a 1 milhão
+// de registros, num arquivo temporário
+// ----------------------------------------------------------------
+#define BENCH_PLACAR_CONSULTAS 200000
+int benchPlacar(void)
 {
-    for (int i = 0; i < INIMIGOS_MAX; i++)
-        inimigos[i].vivo = 0;
+    long casos[] = {10000, 100000, 1000000};
+    printf("bench placar (lotes de %d registros, %d consultas)\n", PLACAR_FILA, BENCH_PLACAR_CONSULTAS);
+
+    for (int c = 0; c < 3; c++)
+    {
+        long n = casos[c];
+        char caminho[] = "/tmp/river_raid_placar_XXXXXX";
+        int fd = mkstemp(caminho);
+        if (fd < 0)
+        {
+            perror("mkstemp");
+            return 1;
+        }
+        close(fd);
+        caminhoPlacar = caminho;
+        if (!abrirPlacar(caminho))
+            return 1;
+
+        // Acréscimo como a thread faz: lote cheio da fila de cada vez
+        long long t0 = agoraNs();
+        for (long feitos = 0; feitos < n; feitos += PLACAR_FILA)
+        {
+            int m = n - feitos < PLACAR_FILA ? (int)(n - feitos) : PLACAR_FILA;
+            for (int i = 0; i < m; i++)
+                placar.pegos[i] = (RegistroPlacar){rngAte(&rngBench, 100000), (uint64_t)(feitos + i),
+                                                   0, (uint32_t)rngAte(&rngBench, 20000), ORIGEM_LOTE};
+            anexarNoPlacar(placar.pegos, m);
+        }
+        long long gastoAnexar = agoraNs() - t0;
+        long descargas = placar.descargas;
+        fecharPlacar();
+
+        t0 = agoraNs();
+        if (!abrirPlacar(caminho))
+            return 1;
+        long long gastoAbrir = agoraNs() - t0;
+        // Delta meio cheio, como no meio de uma execução
+        long falta = PLACAR_DELTA / 2 - (long)(placar.cab->confirmados - placar.cab->ordenados);
+        for (long i = 0; i < falta; i++)
+            placar.pegos[i] = (RegistroPlacar){rngAte(&rngBench, 100000), (uint64_t)(n + i),
+                                               0, (uint32_t)rngAte(&rngBench, 20000), ORIGEM_LOTE};
+        if (falta > 0)
+            anexarNoPlacar(placar.pegos, (int)falta);
+        long total = (long)placar.cab->confirmados;
+
+        long long soma = 0;
+        t0 = agoraNs();
+        for (int q = 0; q < BENCH_PLACAR_CONSULTAS; q++)
+            soma += posicaoNoPlacar(rngAte(&rngBench, 100000));
+        long long gastoIndice = agoraNs() - t0;
+
+        int consultasLineares = n > 100000 ? 200 : 2000;
+        t0 = agoraNs();
+        for (int q = 0; q < consultasLineares; q++)
+        {
+            int64_t score = rngAte(&rngBench, 100000);
+            long maiores = 0;
+            for (long i = 0; i < total; i++)
+                maiores += placar.reg[i].score > score;
+            soma += maiores;
+        }
+        long long gastoLinear = agoraNs() - t0;
+
+        double porIndice = (double)gastoIndice / BENCH_PLACAR_CONSULTAS;
+        double porLinear = (double)gastoLinear / consultasLineares;
+        printf("  %8ld registros  anexar %6.1f ns/reg (%ld msync)  abrir %7.3f ms  "
+               "posicao %6.1f ns (linear %10.1f ns, %.0fx)\n",
+               n, (double)gastoAnexar / n, descargas, gastoAbrir / 1e6,
+               porIndice, porLinear, porIndice > 0 ? porLinear / porIndice : 0.0);
+        sumidouro += (int)soma;
+
+        fecharPlacar();
+        unlink(caminho);
+    }
+    caminhoPlacar = NULL;
+    return 0;
 }
 
-void ReiniciarGasolina(void)
+int rodarBench(const char *nome)
 {
-    for (int i = 0; i < GASOLINA_MAX; i++)
-        postos[i].vivo = 0;
-}
\ No newline at end of file
+    modoHeadless = 1; // sem terminal de verdade
+    // Cada bench escolhe o tamanho que falta; o que vier de --largura/--altura
+    // passa pelo mesmo mínimo do headless
+    if ((LARGURA != 0 && LARGURA < 40) || (ALTURA != 0 && ALTURA < 20))
+    {
+        fprintf(stderr, "O campo virtual precisa ter pelo menos 40x20.\n");
+        return 1;
+    }
+
+    if (strcmp(nome, "render") == 0)
+        return benchRender();
+    if (strcmp(nome, "balas") == 0)
+        return benchBalas();
+    if (strcmp(nome, "entidades") == 0)
+        return benchEntidades();
+    if (strcmp(nome, "nucleo") == 0)
+        return benchNucleo();
+    if (strcmp(nome, "placar") == 0)
+        return benchPlacar();
+
+    fprintf(stderr, "bench desconhecido: %s (use: render, balas, entidades, nucleo, placar)\n", nome);
+    return 1;
+}